@@ -1,39 +1,126 @@
 #include <cstdio>
 #include <cstring>
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+using std::string;
+
+#include "AutocompleteC.h"
 #include "Autocomplete.h"
+#include "Metrics.h"
+
+//
+// functions called by server.c - search handle and result are per thread, index is shared
+//
+
+const size_t max_suggestions = 5;
+
+ac_index       *dictionary = nullptr;
+std::once_flag  loaded;
 
-TAutocomplete ac;
-bool loaded = false;
-string result;
+TMetrics metrics;
+
+TLoadControl        load_control;  // search budget under load
+std::atomic<size_t> in_flight(0);  // requests being served or waiting for a core
 
 void load()
 {
-	ac.load("cities.txt");
-    loaded = true;
+	char error[256];
+	dictionary = ac_open("cities.txt", nullptr, error, sizeof(error));
+	if (!dictionary)
+	{
+		fprintf(stderr, "%s\n", error);
+		return;
+	}
+
+	ac_build_answer_table(dictionary, 2, max_suggestions);  // one and two character queries are answered by lookup
+	ac_set_coalescing(dictionary, 1);                       // users typing the same prefix at once share one search
+
+	metrics.set_index_memory(ac_memory(dictionary));
 }
 
+struct TThreadSearch
+{
+	TThreadSearch()
+		: search(nullptr) {}
+	~TThreadSearch() { ac_search_free(search); }
+
+	ac_search     *search;
+	char           buffer[4096];
+	ac_suggestion  suggestions[max_suggestions];
+	string         result;
+};
+
+thread_local bool degraded_search(false);  // the last search of thread was cut short under load
+
 extern "C" const char* complete(const char* s)
 {
-    if(!loaded) { load(); }
-
-    string query(s);
-	vector<string> results;
-	ac.autocomplete(query, results, 5);
-
-    result = "[";
-    bool first = true;
-    vector<string>::const_iterator i;
-	for(i = results.begin(); i != results.end(); i++)
-    {
-        if(first) { first = false; }
-        else { result.append(",", 1); }
-
-        result.append("\"", 1);
-        result.append((*i).c_str());
-        result.append("\"", 1);
-    }
-    result.append("]", 1);
-
-    return result.c_str();
+	std::call_once(loaded, load);
+
+	thread_local TThreadSearch t;
+	if (!t.search)
+		t.search = ac_search_new(dictionary);
+
+	size_t n(0);
+	degraded_search = false;
+
+	const size_t cores(std::max(1u, std::thread::hardware_concurrency()));
+	const size_t requests(++in_flight);
+
+	std::chrono::steady_clock::time_point begin(std::chrono::steady_clock::now());
+	if (t.search)
+		ac_set_budget(t.search, load_control.budget());
+	if (t.search && ac_complete(t.search, s, max_suggestions, AC_ANY_ATTRIBUTE, t.buffer, sizeof(t.buffer), t.suggestions, &n) != AC_ERROR)
+	{
+		ac_stats cost;
+		ac_last_stats(t.search, &cost);
+
+		TSearchStats stats;
+		stats.expansions    = cost.expansions;
+		stats.frontier_peak = cost.frontier_peak;
+		stats.iteration_cap = cost.iteration_cap != 0;
+		stats.precomputed   = cost.precomputed != 0;
+		stats.degraded      = cost.degraded != 0;
+		stats.coalesced     = cost.coalesced != 0;
+		degraded_search     = stats.degraded;
+
+		const double latency(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+		metrics.record_query(latency, stats);
+		metrics.record_cache(stats.precomputed);
+
+		load_control.record(latency, requests > cores ? requests - cores : 0);  // requests beyond cores wait
+		metrics.set_search_budget(load_control.budget());
+	}
+	--in_flight;
+
+	t.result = "[";
+	for (size_t i(0); i < n; ++i)
+	{
+		if (i > 0) { t.result.append(",", 1); }
+
+		t.result.append("\"", 1);
+		t.result.append(t.suggestions[i].text, t.suggestions[i].length);
+		t.result.append("\"", 1);
+	}
+	t.result.append("]", 1);
+
+	return t.result.c_str();
+}
+
+// 1 if the last complete() of calling thread was cut short under load
+extern "C" int degraded()
+{
+	return degraded_search ? 1 : 0;
+}
+
+// metrics in Prometheus text format
+extern "C" const char* metrics_text()
+{
+	thread_local string result;
+
+	result = metrics.prometheus();
+	return result.c_str();
 }
@@ -0,0 +1,398 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//
+// micro-benchmarks of trie and search building blocks
+//    usage: bench dictionary
+//       - dictionary is in default "weight word" format
+//       - data sets are sampled from the dictionary with fixed seed, so runs are repeatable
+//       - each benchmark is run in several samples; reported are mean ns/op, relative standard deviation among
+//         samples and heap allocations per op
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <new>
+
+#include <fstream>
+using std::ifstream;
+
+#include <chrono>
+
+#include "Autocomplete.h"
+#include "Metrics.h"
+
+typedef std::chrono::steady_clock TClock;
+
+//
+// heap allocations are counted by replacing global operator new
+//
+static size_t n_allocations(0);
+
+void* operator new(size_t size)
+{
+	++n_allocations;
+
+	void *p(malloc(size == 0 ? 1 : size));
+	if (p == nullptr)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+// repeatable pseudo random numbers (LCG)
+class TRandom
+{
+	public:
+		TRandom(const uint64_t seed = 12345)
+			: state(seed) {}
+
+		size_t operator()(const size_t n)  // uniform in [0, n)
+		{
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			return (size_t)((state >> 33) % n);
+		}
+
+	private:
+		uint64_t state;
+};
+
+volatile size_t sink;  // results of benchmarked operations are accumulated here so that they are not optimized away
+
+const unsigned int n_samples = 10;
+
+//
+// runs benchmark n_samples times; run(...) performs n_ops operations, setup(...) prepares the sample and is not measured
+//
+template <class TSetup, class TRun>
+void benchmark(const char *name, const size_t n_ops, TSetup setup, TRun run)
+{
+	double sum(.0), sum2(.0);
+	size_t allocations(0);
+
+	for (unsigned int sample(0); sample < n_samples; ++sample)
+	{
+		setup();
+
+		size_t             allocations_before(n_allocations);
+		TClock::time_point begin(TClock::now());
+		run();
+		double ns(std::chrono::duration<double, std::nano>(TClock::now() - begin).count() / n_ops);
+
+		allocations += n_allocations - allocations_before;
+		sum         += ns;
+		sum2        += ns * ns;
+	}
+
+	double mean(sum / n_samples);
+	double deviation(std::sqrt(std::max(.0, sum2 / n_samples - mean * mean)));
+
+	fprintf(stdout, "%-34s %10.1f %7.1f%% %10.2f\n", name, mean, 100. * deviation / mean, (double)allocations / n_samples / n_ops);
+}
+
+void no_setup() {}
+
+//
+// exposes TTrie building blocks (friend of TTrie)
+//
+class TBenchTrie : public TTrie
+{
+	public:
+		void add(const string &s, const float &weight) { TTrie::add(s, weight, 0); }
+		void finalize()                                { TTrie::finalize(0); }
+};
+
+//
+// exposes search building blocks
+//
+class TBenchAutocomplete : public TAutocomplete
+{
+	public:
+		typedef TAutocomplete::TCandidate  TCandidate;
+		typedef TAutocomplete::TCandidates TCandidates;
+		typedef TAutocomplete::TAction     TAction;
+
+		void split(const TCandidate &candidate, const string &query, float &best_left, TCandidate &best, float &best_right, TAction &action)
+		{
+			const uint64_t filter(TTrie::any_attribute);
+			TAutocomplete::split(candidate, query.begin(), query.end(), best_left, best, best_right, action, filter);
+		}
+
+		// deepest node on the path of most probable subtrees that has only one subtree
+		size_t narrow_node() const
+		{
+			size_t id(0);
+			while (trie.node(id).sub_trees.size() != 1 && !trie.node(id).sub_trees.empty())
+				id = trie.node(id).sub_trees[0];
+
+			return id;
+		}
+};
+
+void read_dictionary(const char *file_name, vector<string> &words, vector<float> &weights)
+{
+	ifstream f(file_name);
+	if (!f)
+	{
+		fprintf(stderr, "cannot open %s\n", file_name);
+		exit(1);
+	}
+
+	string line;
+	while (getline(f, line))
+	{
+		size_t space(line.find(' '));
+		if (space == string::npos)
+			continue;
+
+		if (line[line.size() - 1] == '\r')
+			line.resize(line.size() - 1);
+
+		weights.push_back((float)atof(line.substr(0, space).c_str()));
+		words.push_back(line.substr(space + 1));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: bench dictionary\n");
+		return 1;
+	}
+
+	vector<string> words;
+	vector<float>  weights;
+	read_dictionary(argv[1], words, weights);
+	if (words.empty())
+	{
+		fprintf(stderr, "no words in %s\n", argv[1]);
+		return 1;
+	}
+
+	TBenchAutocomplete ac;
+	ac.load(argv[1]);
+
+	typedef TBenchAutocomplete::TCandidate  TCandidate;
+	typedef TBenchAutocomplete::TCandidates TCandidates;
+	typedef TBenchAutocomplete::TAction     TAction;
+
+	TRandom random;
+
+	// fixed data sets sampled from dictionary
+	const size_t n_words(std::min(words.size(), (size_t)100000));
+
+	vector<unsigned char> keys;  // pairs of characters
+	for (size_t i(0); i < 2000000; ++i)
+	{
+		const string &word(words[random(words.size())]);
+		keys.push_back((unsigned char)word[random(word.size())]);
+	}
+
+	vector<string> queries;  // dictionary words with one substituted character
+	for (size_t i(0); i < 1000; ++i)
+	{
+		string query(words[random(words.size())]);
+		query[random(query.size())] = (char)('a' + random(26));
+		queries.push_back(query);
+	}
+
+	fprintf(stdout, "%-34s %10s %8s %10s\n", "benchmark", "ns/op", "+-", "allocs/op");
+
+	TKeyboard keyboard;
+	benchmark("TKeyboard::distance", keys.size() / 2, no_setup, [&]()
+	{
+		size_t sum(0);
+		for (size_t i(0); i < keys.size(); i += 2)
+			sum += keyboard.distance(keys[i], keys[i + 1]);
+		sink = sum;
+	});
+
+	TBenchTrie *trie(nullptr);
+	benchmark("TTrie::add", n_words, [&]() { delete trie; trie = new TBenchTrie(); }, [&]()
+	{
+		for (size_t i(0); i < n_words; ++i)
+			trie->add(words[i], weights[i]);
+	});
+
+	benchmark("TTrie::finalize (per node)", trie->size(), [&]()
+	{
+		delete trie;
+		trie = new TBenchTrie();
+		for (size_t i(0); i < n_words; ++i)
+			trie->add(words[i], weights[i]);
+	}, [&]()
+	{
+		trie->finalize();
+	});
+	delete trie;
+
+	const TTrie &index(ac.index());
+	const size_t n_candidates(1000000);
+
+	benchmark("TCandidate construction", n_candidates, no_setup, [&]()
+	{
+		size_t sum(0);
+		for (size_t i(0); i < n_candidates; ++i)
+		{
+			const string &query(queries[i % queries.size()]);
+			TCandidate candidate(index.ref(0), query.begin(), query.substr(0, 0), (float)1., 0);
+			sum += candidate.n_errors;
+		}
+		sink = sum;
+	});
+
+	TCandidate prototype(index.ref(0), queries[0].begin(), queries[0].substr(0, 8), (float)1., 0);
+	benchmark("TCandidate copy", n_candidates, no_setup, [&]()
+	{
+		size_t sum(0);
+		for (size_t i(0); i < n_candidates; ++i)
+		{
+			TCandidate candidate(prototype);
+			sum += candidate.suggestion.size();
+		}
+		sink = sum;
+	});
+
+	// frontier of realistic sizes: push + pop of candidates with random probabilities
+	const size_t frontiers[] = {16, 256, 4096, 65536};
+	for (size_t f(0); f < sizeof(frontiers) / sizeof(frontiers[0]); ++f)
+	{
+		TCandidates candidates;
+		const size_t n_ops(200000);
+
+		char name[64];
+		sprintf(name, "frontier push+pop (%u)", (unsigned int)frontiers[f]);
+
+		benchmark(name, n_ops, [&]()
+		{
+			candidates = TCandidates();
+			for (size_t i(0); i < frontiers[f]; ++i)
+				candidates.push(TCandidate(prototype.node, prototype.begin, prototype.end, prototype.query, prototype.suggestion,
+				                           (float)1., (float)random(1000000) / 1e6f, 0));
+		}, [&]()
+		{
+			for (size_t i(0); i < n_ops; ++i)
+			{
+				candidates.pop();
+				candidates.push(TCandidate(prototype.node, prototype.begin, prototype.end, prototype.query, prototype.suggestion,
+				                           (float)1., (float)random(1000000) / 1e6f, 0));
+			}
+		});
+	}
+
+	// split at the root (widest node) and at a node with a single subtree
+	const size_t nodes[] = {0, ac.narrow_node()};
+	const char  *names[] = {"split (wide node, %u subtrees)", "split (narrow node, %u subtree)"};
+	for (size_t n(0); n < 2; ++n)
+	{
+		const size_t n_ops(100000);
+		char name[64];
+		sprintf(name, names[n], (unsigned int)index.node(nodes[n]).sub_trees.size());
+
+		benchmark(name, n_ops, no_setup, [&]()
+		{
+			float  best_left, best_right;
+			size_t sum(0);
+
+			for (size_t i(0); i < n_ops; ++i)
+			{
+				const string &query(queries[i % queries.size()]);
+				TCandidate candidate(index.ref(nodes[n]), query.begin(), "", (float)1., 0);
+				TCandidate best(candidate);
+				TAction    action(candidate.begin);
+
+				ac.split(candidate, query, best_left, best, best_right, action);
+				sum += best.suggestion.size();
+			}
+			sink = sum;
+		});
+	}
+
+	// child lookup by label in the first node of each kind - TTrie scans subtree list, TArtTrie depends on node kind
+	TArtTrie art;
+	art.build(index);
+
+	vector<size_t> level_order(1, 0);  // TArtTrie ids are TTrie nodes in level order
+	for (size_t i(0); i < level_order.size(); ++i)
+		level_order.insert(level_order.end(), index.node(level_order[i]).sub_trees.begin(), index.node(level_order[i]).sub_trees.end());
+
+	const char *kinds[] = {"small", "medium", "large"};
+	for (unsigned int kind(TArtTrie::small); kind <= TArtTrie::large; ++kind)
+	{
+		size_t id(0);
+		while (id < art.size() && (art.ref(id)->kind != kind || art.ref(id)->n_sub_trees < 2))
+			++id;
+
+		if (id == art.size())
+			continue;
+
+		const TTrie::Node &node(index.node(level_order[id]));
+		const size_t       n_ops(1000000);
+
+		vector<char> labels;
+		for (size_t i(0); i < n_ops; ++i)
+			labels.push_back(index.node(node.sub_trees[random(node.sub_trees.size())]).c);
+
+		char name[64];
+		sprintf(name, "TTrie child lookup (%u subtrees)", (unsigned int)node.sub_trees.size());
+		benchmark(name, n_ops, no_setup, [&]()
+		{
+			size_t sum(0);
+			for (size_t i(0); i < n_ops; ++i)
+			{
+				TTrie::TSubTreeIt j(node.sub_trees.begin());
+				while (index.node(*j).c != labels[i])
+					++j;
+				sum += *j;
+			}
+			sink = sum;
+		});
+
+		sprintf(name, "TArtTrie::find (%s)", kinds[kind]);
+		benchmark(name, n_ops, no_setup, [&]()
+		{
+			size_t sum(0);
+			for (size_t i(0); i < n_ops; ++i)
+				sum += *art.find(art.ref(id), labels[i]);
+			sink = sum;
+		});
+	}
+
+	// metrics recorded per query by server
+	TMetrics     metrics;
+	TSearchStats stats;
+	const size_t n_records(1000000);
+
+	benchmark("TMetrics::record_query", n_records, no_setup, [&]()
+	{
+		for (size_t i(0); i < n_records; ++i)
+		{
+			stats.expansions    = (unsigned int)(i % 5000);
+			stats.frontier_peak = (unsigned int)(i % 300);
+			metrics.record_query((double)(i % 20000), stats);
+		}
+	});
+
+	return 0;
+}
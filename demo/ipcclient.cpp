@@ -0,0 +1,168 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//
+// replays query log against ipcserver and reports round trip latency percentiles
+//    usage: ipcclient [-c clients] query_log [shm_name]
+//       - transport alone is measured by round trips of empty queries (no search)
+//       - with -c the query log is replayed by clients sending queries back to back (overload test); share of
+//         responses degraded by server load control is reported, compare with ipcserver -f
+//
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <atomic>
+#include <thread>
+
+#include <fstream>
+using std::ifstream;
+
+#include <algorithm>
+using std::sort;
+
+#include <chrono>
+
+#include "Ipc.h"
+
+typedef std::chrono::steady_clock TClock;
+
+double percentile(const vector<double> &sorted, const double p)
+{
+	return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+void report(const char *name, vector<double> &latency)
+{
+	sort(latency.begin(), latency.end());
+	fprintf(stdout, "%-10s p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", name, percentile(latency, .50), percentile(latency, .99), latency.back());
+}
+
+// queries are shared by clients; every client has its own channel
+void overload(const vector<string> &queries, const size_t n_clients, const string &name)
+{
+	vector<vector<double> > latency(n_clients);
+	vector<size_t>          degraded(n_clients, 0);
+	std::atomic<size_t>     next(0);
+
+	auto client = [&](const size_t c)
+	{
+		TIpcClient     ipc(name);
+		vector<string> suggestions;
+		vector<float>  scores;
+
+		for (size_t i(next++); i < queries.size(); i = next++)
+		{
+			TClock::time_point begin(TClock::now());
+			degraded[c] += !ipc.autocomplete(queries[i], suggestions, scores);
+			latency[c].push_back(std::chrono::duration<double, std::micro>(TClock::now() - begin).count());
+		}
+	};
+
+	TClock::time_point  begin(TClock::now());
+	vector<std::thread> threads;
+	for (size_t c(0); c < n_clients; ++c)
+		threads.push_back(std::thread(client, c));
+	for (vector<std::thread>::iterator i(threads.begin()); i != threads.end(); ++i)
+		i->join();
+	const double elapsed(std::chrono::duration<double>(TClock::now() - begin).count());
+
+	vector<double> all;
+	size_t         n_degraded(0);
+	for (size_t c(0); c < n_clients; ++c)
+	{
+		all.insert(all.end(), latency[c].begin(), latency[c].end());
+		n_degraded += degraded[c];
+	}
+
+	fprintf(stdout, "clients   %10u\n", (unsigned int)n_clients);
+	fprintf(stdout, "queries   %10u  %.0f per second\n", (unsigned int)all.size(), all.size() / elapsed);
+	report("query", all);
+	fprintf(stdout, "degraded  %10.1f%%\n", 100. * n_degraded / all.size());
+}
+
+int main(int argc, char* argv[])
+{
+	size_t n_clients(0);
+	if (argc > 2 && string(argv[1]) == "-c")
+	{
+		n_clients = (size_t)atoi(argv[2]);
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: ipcclient [-c clients] query_log [shm_name]\n");
+		return 1;
+	}
+
+	ifstream f(argv[1]);
+	if (!f)
+	{
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 1;
+	}
+
+	vector<string> queries;
+	string         query;
+	while (getline(f, query))
+	{
+		if (!query.empty() && query[query.size() - 1] == '\r')
+			query.resize(query.size() - 1);
+
+		if (!query.empty())
+			queries.push_back(query);
+	}
+
+	if (queries.empty())
+	{
+		fprintf(stderr, "no queries in %s\n", argv[1]);
+		return 1;
+	}
+
+	if (n_clients > 0)
+	{
+		overload(queries, n_clients, argc > 2 ? argv[2] : "/autocomplete");
+		return 0;
+	}
+
+	TIpcClient     client(argc > 2 ? argv[2] : "/autocomplete");
+	vector<string> suggestions;
+	vector<float>  scores;
+
+	vector<double> empty, latency;
+	for (size_t i(0); i < queries.size(); ++i)
+	{
+		TClock::time_point begin(TClock::now());
+		client.autocomplete("", suggestions, scores);
+		empty.push_back(std::chrono::duration<double, std::micro>(TClock::now() - begin).count());
+	}
+
+	for (vector<string>::const_iterator i(queries.begin()); i != queries.end(); ++i)
+	{
+		TClock::time_point begin(TClock::now());
+		client.autocomplete(*i, suggestions, scores);
+		latency.push_back(std::chrono::duration<double, std::micro>(TClock::now() - begin).count());
+	}
+
+	fprintf(stdout, "queries   %10u\n", (unsigned int)queries.size());
+	report("transport", empty);
+	report("query", latency);
+
+	return 0;
+}
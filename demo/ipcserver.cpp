@@ -0,0 +1,125 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//
+// serves autocomplete to clients on the same host over shared memory (see TIpcServer, TIpcClient)
+//    usage: ipcserver [-f | -t target_us] dictionary [shm_name]
+//       - default shm name is /autocomplete
+//       - under load search budget is cut so that estimated response time stays below target (TLoadControl, default
+//         20 ms); responses with cut search are flagged as degraded; -f -> always full search
+//       - stops on SIGINT or SIGTERM
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+
+#include <chrono>
+
+#include "Autocomplete.h"
+#include "Ipc.h"
+#include "Metrics.h"
+
+TIpcServer *server(nullptr);
+
+extern "C" void stop(int)
+{
+	if (server)
+		server->stop();
+}
+
+// collects suggestions with their scores
+class TScored : public TSuggestionHandler
+{
+    public:
+		bool found(const string &suggestion, const float &score)
+		{
+			suggestions.push_back(suggestion);
+			scores.push_back(score);
+			return true;
+		}
+
+		vector<string> suggestions;
+		vector<float>  scores;
+};
+
+int main(int argc, char* argv[])
+{
+	bool   full(false);
+	double target_us(20000.);
+	if (argc > 1 && string(argv[1]) == "-f")
+	{
+		full = true;
+
+		--argc;
+		++argv;
+	}
+	else
+	if (argc > 2 && string(argv[1]) == "-t")
+	{
+		target_us = atof(argv[2]);
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: ipcserver [-f | -t target_us] dictionary [shm_name]\n");
+		return 1;
+	}
+
+	try
+	{
+		TAutocomplete ac;
+		ac.load(argv[1]);
+		ac.build_answer_table();
+
+		TIpcServer ipc(argc > 2 ? argv[2] : "/autocomplete");
+		server = &ipc;
+
+		signal(SIGINT, stop);
+		signal(SIGTERM, stop);
+
+		fprintf(stdout, "serving %s\n", argv[1]);
+		fflush(stdout);
+
+		TLoadControl load(target_us);
+
+		TIpcRequest request;
+		while (ipc.receive(request))
+		{
+			TScored      results;
+			TSearchStats stats;
+
+			std::chrono::steady_clock::time_point begin(std::chrono::steady_clock::now());
+			ac.autocomplete(request.query, results, request.max_suggestions, request.filter, stats, full ? 0 : load.budget());
+			load.record(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count(), ipc.pending());
+
+			ipc.respond(request, results.suggestions, results.scores, stats.degraded);
+		}
+
+		server = nullptr;
+	}
+	catch (const std::exception &e)
+	{
+		server = nullptr;
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
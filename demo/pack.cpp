@@ -0,0 +1,163 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//
+// packs dictionary into index file for out-of-core search (TPagedAutocomplete, see replay -p)
+//    usage: pack [-c word_column,weight_column[,attribute_column]] [-u] [-p page_size] dictionary index_file
+//       - dictionary can be gzip compressed; -c reads it as CSV with header, -u folds case (see replay)
+//       - reports pages touched by a walk from root to the end of a word, packed vs nodes in plain level order
+//
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "AutocompleteUtils.h"
+#include "PagedTrie.h"
+
+// pages on paths from root to ends of words: sum and max
+struct TWalks
+{
+	TWalks()
+		: words(0), pages(0), max_pages(0) {}
+
+	void add(const size_t path_pages)
+	{
+		++words;
+		pages += path_pages;
+		if (path_pages > max_pages)
+			max_pages = path_pages;
+	}
+
+	size_t words, pages, max_pages;
+};
+
+TWalks packed_walks(const TPagedTrie &trie)
+{
+	TWalks walks;
+
+	vector<std::pair<size_t, size_t> > stack(1, std::make_pair((size_t)0, (size_t)1));  // node, pages on path
+	while (!stack.empty())
+	{
+		const size_t node(stack.back().first), pages(stack.back().second);
+		stack.pop_back();
+
+		TPagedTrie::TNodeRef ref(trie.ref(node));
+		if (TPagedTrie::label(ref) == (char)0 && node != 0)
+			walks.add(pages);
+
+		for (TPagedTrie::TSubTreeIt i(TPagedTrie::begin(ref)); i != TPagedTrie::end(ref); ++i)
+			stack.push_back(std::make_pair(*i, pages + (trie.page(*i) != trie.page(node))));
+	}
+
+	return walks;
+}
+
+// nodes numbered in level order (as TArtTrie), page_size / 16 nodes per page
+TWalks level_order_walks(const TTrie &trie, const size_t page_size)
+{
+	const size_t slots(page_size / sizeof(TPagedTrie::TNode));
+
+	vector<size_t> level_order(1, 0), id(trie.size(), 0);
+	for (size_t i(0); i < level_order.size(); ++i)
+	{
+		id[level_order[i]] = i;
+		const vector<size_t> &sub_trees(trie.node(level_order[i]).sub_trees);
+		level_order.insert(level_order.end(), sub_trees.begin(), sub_trees.end());
+	}
+
+	TWalks walks;
+
+	vector<std::pair<size_t, size_t> > stack(1, std::make_pair((size_t)0, (size_t)1));
+	while (!stack.empty())
+	{
+		const size_t node(stack.back().first), pages(stack.back().second);
+		stack.pop_back();
+
+		if (trie.node(node).c == (char)0 && node != 0)
+			walks.add(pages);
+
+		const vector<size_t> &sub_trees(trie.node(node).sub_trees);
+		for (vector<size_t>::const_iterator i(sub_trees.begin()); i != sub_trees.end(); ++i)
+			stack.push_back(std::make_pair(*i, pages + (id[*i] / slots != id[node] / slots)));
+	}
+
+	return walks;
+}
+
+int main(int argc, char* argv[])
+{
+	TTrie::Format format;
+	if (argc > 2 && string(argv[1]) == "-c")
+	{
+		if (sscanf(argv[2], "%u,%u,%u", &format.word_column, &format.weight_column, &format.attribute_column) < 2)
+		{
+			fprintf(stderr, "invalid column mapping %s\n", argv[2]);
+			return 1;
+		}
+
+		format.delimiter      = ',';
+		format.default_weight = 1.;
+		format.header         = true;
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc > 1 && string(argv[1]) == "-u")
+	{
+		format.fold_case = true;
+
+		--argc;
+		++argv;
+	}
+
+	size_t page_size(4096);
+	if (argc > 2 && string(argv[1]) == "-p")
+	{
+		page_size = (size_t)atoi(argv[2]);
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc != 3)
+	{
+		fprintf(stderr, "usage: pack [-c word_column,weight_column[,attribute_column]] [-u] [-p page_size] dictionary index_file\n");
+		return 1;
+	}
+
+	TTrie dictionary;
+	dictionary.load(argv[1], format);
+	TPagedTrie::write(dictionary, argv[2], page_size);
+
+	TPagedTrie trie;
+	trie.open(argv[2]);
+
+	size_t used(0);
+	for (size_t i(1); i < trie.size(); ++i)
+		used += TPagedTrie::label(trie.ref(i)) != (char)0 || TPagedTrie::prob(trie.ref(i)) > (float).0;
+
+	fprintf(stdout, "index      %10.1f MB  %s\n", trie.memory() / (1024. * 1024.), argv[2]);
+	fprintf(stdout, "pages      %10u of %u bytes, %.1f%% of node slots used\n", (unsigned int)trie.pages(), (unsigned int)trie.page_size(),
+		    100. * (used + 1) / trie.size());
+
+	const TWalks packed(packed_walks(trie)), level_order(level_order_walks(dictionary, page_size));
+	fprintf(stdout, "\npages per word  %8s %8s\n", "mean", "max");
+	fprintf(stdout, "packed          %8.2f %8u\n", (double)packed.pages / packed.words, (unsigned int)packed.max_pages);
+	fprintf(stdout, "level order     %8.2f %8u\n", (double)level_order.pages / level_order.words, (unsigned int)level_order.max_pages);
+
+	return 0;
+}
@@ -0,0 +1,905 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//
+// replays query log against dictionary and reports latency percentiles
+//    usage: replay [-c word_column,weight_column[,attribute_column] [-f attribute]] [-u] [-m | -l | -r | -p pinned_mb] [-b] [-i] [-j] [-k threads] [-g] [-s] [-a length] [-e] dictionary query_log [training_log]
+//       - dictionary can be gzip compressed
+//       - comma separated dictionaries with optional priors, e.g. cities.txt:2,streets.txt, are searched together
+//         (TFederatedAutocomplete); expansions are compared with separate searches of dictionaries; -f selects dictionary
+//       - with -m common suffixes in trie are shared (TAutocomplete::minimize); nodes and memory are reported before and after
+//       - with -l dictionary is searched in succinct trie (TLoudsAutocomplete)
+//       - with -r dictionary is searched in trie with adaptive node kinds (TArtAutocomplete)
+//       - with -p dictionary is index file made by pack and searched out of core (TPagedAutocomplete); index is evicted
+//         from page cache before replay and its first pinned_mb megabytes (upper levels) are locked in memory
+//       - with -c dictionary is read as CSV with header, e.g. -c 1,4 for worldcitiespop.txt.gz (entries without population get weight 1)
+//       - with -f queries are restricted to words with given attribute value, e.g. -c 2,1,0 -f capital
+//       - with -u dictionary is case folded: spellings of a word share trie nodes, the most weighted one is displayed
+//         (TTrie::Format::fold_case)
+//       - if training log is given, trie nodes are relaid by access frequency of training queries before replay
+//       - latency of the first suggestion is reported as well (suggestions are streamed, see TSuggestionHandler)
+//       - with -s search is seeded by typo index for queries with wrong first characters (TAutocomplete::build_typo_index)
+//       - with -a suggestions of queries up to given length are precomputed (TAutocomplete::build_answer_table)
+//       - with -b beam search is replayed for a range of beam widths; recall@5 is measured against best-first search
+//       - with -i throughput of interleaved batches of queries is compared with queries searched back to back
+//       - with -j latency of queries that expand over 2000 candidates and are finished in parallel is reported by number
+//         of threads (TAutocomplete::set_parallel)
+//       - with -k queries are replayed by concurrent threads, with and without coalescing of identical queries (TCoalescing)
+//       - with -e suggestions and scores are compared with the error model and keyboard layout evaluated at run time
+//         (TReferenceAutocomplete); queries that differ are listed
+//       - with -g the second page of suggestions is fetched by resuming the search of the first page and compared with
+//         a new search for both pages (TAutocomplete::resume)
+//       - run under "perf stat -e cache-misses,cache-references" to compare cache behaviour with and without relayout
+//       - page faults and reads from storage per query are reported; memory limit can be set by cgroup, e.g.
+//         systemd-run --scope -p MemoryMax=64M ./replay -p 8 dictionary.pages queries.txt
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <fstream>
+using std::ifstream;
+
+#include <algorithm>
+using std::sort;
+using std::find;
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "Autocomplete.h"
+
+typedef std::chrono::steady_clock TClock;
+
+double elapsed_us(const TClock::time_point &begin, const TClock::time_point &end)
+{
+	return std::chrono::duration<double, std::micro>(end - begin).count();
+}
+
+void read_queries(const char *file_name, vector<string> &queries)
+{
+	ifstream f(file_name);
+	if (!f)
+	{
+		fprintf(stderr, "cannot open %s\n", file_name);
+		exit(1);
+	}
+
+	string query;
+	while (getline(f, query))
+	{
+		if (!query.empty() && query[query.size() - 1] == '\r')
+			query.resize(query.size() - 1);
+
+		if (!query.empty())
+			queries.push_back(query);
+	}
+}
+
+double percentile(const vector<double> &sorted, const double p)
+{
+	return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+// records when the first suggestion of a query is streamed
+class TFirstSuggestion : public TSuggestionHandler
+{
+    public:
+		TFirstSuggestion()
+			: found_any(false) {}
+
+		bool found(const string &, const float &)
+		{
+			if (!found_any)
+				first = TClock::now();
+
+			found_any = true;
+			return true;
+		}
+
+		bool               found_any;
+		TClock::time_point first;
+};
+
+// collects streamed suggestions with their scores
+class TScoredSuggestions : public TSuggestionHandler
+{
+    public:
+		TScoredSuggestions()
+			: total_score(.0) {}
+
+		bool found(const string &suggestion, const float &score)
+		{
+			suggestions.push_back(suggestion);
+			scores.push_back(score);
+			total_score += score;
+			return true;
+		}
+
+		vector<string> suggestions;
+		vector<float>  scores;
+		double         total_score;
+};
+
+//
+// latency and recall@5 of beam search against best-first search by beam width
+//    - score is total score of beam search suggestions relative to best-first ones; best-first search is not exhaustive
+//      either, so wide beams can find suggestions scored higher than best-first ones
+//
+template <class TAutocompleteType>
+void sweep_beam_width(TAutocompleteType &ac, const vector<string> &queries, const uint64_t filter)
+{
+	const size_t max_suggestions(5);
+
+	vector<TScoredSuggestions> exact(queries.size());
+	double                     exact_score(.0);
+	for (size_t i(0); i < queries.size(); ++i)
+	{
+		exact[i].total_score = .0;
+		ac.autocomplete(queries[i], exact[i], max_suggestions, filter);
+		exact_score += exact[i].total_score;
+	}
+
+	fprintf(stdout, "\n%-10s %10s %10s %10s %10s %10s\n", "width", "recall@5", "score", "mean us", "p99 us", "max us");
+
+	for (size_t width(1); width <= 1024; width *= 2)
+	{
+		ac.set_beam_width(width);
+
+		vector<double> latency;
+		size_t         found(0), expected(0);
+		double         score(.0);
+		for (size_t i(0); i < queries.size(); ++i)
+		{
+			TScoredSuggestions beam;
+			beam.total_score = .0;
+
+			TClock::time_point begin(TClock::now());
+			ac.autocomplete(queries[i], beam, max_suggestions, filter);
+			latency.push_back(elapsed_us(begin, TClock::now()));
+
+			score    += beam.total_score;
+			expected += exact[i].suggestions.size();
+			for (vector<string>::const_iterator j(exact[i].suggestions.begin()); j != exact[i].suggestions.end(); ++j)
+				if (find(beam.suggestions.begin(), beam.suggestions.end(), *j) != beam.suggestions.end())
+					++found;
+		}
+
+		double sum(.0);
+		for (vector<double>::const_iterator i(latency.begin()); i != latency.end(); ++i)
+			sum += *i;
+
+		sort(latency.begin(), latency.end());
+		fprintf(stdout, "%-10u %10.3f %10.3f %10.1f %10.1f %10.1f\n", (unsigned int)width, expected > 0 ? (double)found / expected : 1., 
+			    exact_score > .0 ? score / exact_score : 1., sum / latency.size(), percentile(latency, .99), latency.back());
+	}
+
+	ac.set_beam_width(0);
+}
+
+//
+// throughput of queries searched back to back vs interleaved batch search by number of interleaved queries
+//    - suggestions of both must be the same
+//
+template <class TAutocompleteType>
+void sweep_interleaving(TAutocompleteType &ac, const vector<string> &queries, const uint64_t filter)
+{
+	const size_t max_suggestions(5);
+	const size_t batch(256);  // queries per call
+
+	vector<vector<string> > expected(queries.size());
+	TClock::time_point      begin(TClock::now());
+	for (size_t i(0); i < queries.size(); ++i)
+		ac.autocomplete(queries[i], expected[i], max_suggestions, filter);
+	const double back_to_back(elapsed_us(begin, TClock::now()));
+
+	fprintf(stdout, "\n%-10s %10s %10s %10s\n", "width", "us/query", "speedup", "different");
+	fprintf(stdout, "%-10s %10.2f %10.2f %10s\n", "-", back_to_back / queries.size(), 1., "-");
+
+	for (size_t width(1); width <= 32; width *= 2)
+	{
+		vector<string>          queries_batch;
+		vector<vector<string> > suggestions;
+		vector<TSearchStats>    stats;
+		size_t                  different(0);
+		double                  elapsed(.0);
+		for (size_t first(0); first < queries.size(); first += batch)
+		{
+			queries_batch.assign(queries.begin() + first, queries.begin() + std::min(queries.size(), first + batch));
+
+			begin = TClock::now();
+			ac.autocomplete(queries_batch, suggestions, stats, max_suggestions, filter, width);
+			elapsed += elapsed_us(begin, TClock::now());
+
+			for (size_t i(0); i < queries_batch.size(); ++i)
+				different += suggestions[i] != expected[first + i];
+		}
+
+		fprintf(stdout, "%-10u %10.2f %10.2f %10u\n", (unsigned int)width, elapsed / queries.size(), back_to_back / elapsed, (unsigned int)different);
+	}
+}
+
+//
+// latency of expensive queries finished in parallel by number of threads (see set_parallel)
+//    - suggestions must be the same as of single thread search; suggestions of equal score can be ordered differently
+//
+template <class TAutocompleteType>
+void sweep_parallel(TAutocompleteType &ac, const vector<string> &queries, const uint64_t filter)
+{
+	const size_t max_suggestions(5);
+	const size_t min_expansions(2000);
+
+	fprintf(stdout, "\n%-10s %10s %10s %10s %10s %10s\n", "threads", "mean us", "p99 us", "max us", "split", "different");
+
+	vector<vector<string> > expected(queries.size());
+	for (unsigned int threads(1); threads <= 8; threads *= 2)
+	{
+		ac.set_parallel(threads, min_expansions);
+
+		vector<double> latency;
+		size_t         split(0), different(0);
+		for (size_t i(0); i < queries.size(); ++i)
+		{
+			vector<string> suggestions;
+
+			TClock::time_point begin(TClock::now());
+			ac.autocomplete(queries[i], suggestions, max_suggestions, filter);
+			latency.push_back(elapsed_us(begin, TClock::now()));
+
+			split += ac.stats().expansions >= min_expansions;
+			if (threads == 1)
+				expected[i].swap(suggestions);
+			else
+				different += suggestions != expected[i];
+		}
+
+		double sum(.0);
+		for (vector<double>::const_iterator i(latency.begin()); i != latency.end(); ++i)
+			sum += *i;
+
+		sort(latency.begin(), latency.end());
+		fprintf(stdout, "%-10u %10.1f %10.1f %10.1f %10u %10u\n", threads, sum / latency.size(), percentile(latency, .99), latency.back(),
+			    threads > 1 ? (unsigned int)split : 0, (unsigned int)different);
+	}
+
+	ac.set_parallel(0);
+}
+
+//
+// queries replayed by concurrent threads with and without coalescing of identical in-flight queries (see TCoalescing)
+//
+template <class TAutocompleteType>
+void replay_coalescing(TAutocompleteType &ac, const vector<string> &queries, const uint64_t filter, const unsigned int n_threads)
+{
+	const size_t max_suggestions(5);
+
+	fprintf(stdout, "\n%-10s %10s %10s %10s %10s %10s\n", "coalesce", "mean us", "p99 us", "searched", "coalesced", "expanded");
+
+	for (int coalesce(0); coalesce < 2; ++coalesce)
+	{
+		TCoalescing<TAutocompleteType> coalescing(ac);
+
+		vector<vector<double> > latency(n_threads);
+		std::atomic<size_t>     next(0), expansions(0);
+
+		auto worker = [&](const unsigned int t)
+		{
+			for (size_t i(next++); i < queries.size(); i = next++)
+			{
+				TScoredSuggestions suggestions;
+				TSearchStats       stats;
+
+				TClock::time_point begin(TClock::now());
+				if (coalesce)
+					coalescing.autocomplete(queries[i], suggestions, max_suggestions, filter, stats);
+				else
+					ac.autocomplete(queries[i], suggestions, max_suggestions, filter, stats);
+				latency[t].push_back(elapsed_us(begin, TClock::now()));
+
+				if (!stats.coalesced)
+					expansions += stats.expansions;
+			}
+		};
+
+		vector<std::thread> threads;
+		for (unsigned int t(0); t < n_threads; ++t)
+			threads.push_back(std::thread(worker, t));
+		for (vector<std::thread>::iterator i(threads.begin()); i != threads.end(); ++i)
+			i->join();
+
+		vector<double> all;
+		for (unsigned int t(0); t < n_threads; ++t)
+			all.insert(all.end(), latency[t].begin(), latency[t].end());
+
+		double sum(.0);
+		for (vector<double>::const_iterator i(all.begin()); i != all.end(); ++i)
+			sum += *i;
+
+		sort(all.begin(), all.end());
+		fprintf(stdout, "%-10s %10.1f %10.1f %10u %10u %10.1f\n", coalesce ? "yes" : "no", sum / all.size(), percentile(all, .99),
+			    coalesce ? (unsigned int)coalescing.searches() : (unsigned int)all.size(), (unsigned int)coalescing.coalesced(),
+			    (double)expansions / all.size());
+		if (coalesce)
+			fprintf(stdout, "saved     %10u expansions, %.1f%% of search work\n", (unsigned int)coalescing.saved_expansions(),
+				    100. * coalescing.saved_expansions() / (coalescing.saved_expansions() + expansions));
+	}
+}
+
+//
+// second page of suggestions: resumed search of the first page vs new search for both pages
+//
+template <class TAutocompleteType>
+void sweep_pagination(TAutocompleteType &ac, const vector<string> &queries, const uint64_t filter)
+{
+	const size_t page(5);
+
+	vector<double> resumed_latency, searched_latency;
+	size_t         first_expansions(0), resumed_expansions(0), searched_expansions(0), different(0);
+	for (vector<string>::const_iterator i(queries.begin()); i != queries.end(); ++i)
+	{
+		typename TAutocompleteType::TContinuation continuation;
+		TScoredSuggestions                        pages;
+		TSearchStats                              stats;
+
+		ac.autocomplete(*i, pages, page, filter, stats, continuation);
+		first_expansions += stats.expansions;
+
+		TClock::time_point begin(TClock::now());
+		ac.resume(continuation, pages, page, stats);
+		resumed_latency.push_back(elapsed_us(begin, TClock::now()));
+		resumed_expansions += stats.expansions;
+
+		TScoredSuggestions both;
+		begin = TClock::now();
+		ac.autocomplete(*i, both, 2 * page, filter, stats);
+		searched_latency.push_back(elapsed_us(begin, TClock::now()));
+		searched_expansions += stats.expansions;
+
+		different += pages.suggestions != both.suggestions;
+	}
+
+	double resumed_sum(.0), searched_sum(.0);
+	for (size_t i(0); i < resumed_latency.size(); ++i)
+	{
+		resumed_sum  += resumed_latency[i];
+		searched_sum += searched_latency[i];
+	}
+
+	sort(resumed_latency.begin(), resumed_latency.end());
+	sort(searched_latency.begin(), searched_latency.end());
+
+	fprintf(stdout, "\n%-10s %10s %10s %10s\n", "page 2", "mean us", "p99 us", "expanded");
+	fprintf(stdout, "%-10s %10.1f %10.1f %10.1f\n", "resumed", resumed_sum / queries.size(), percentile(resumed_latency, .99),
+		    (double)resumed_expansions / queries.size());
+	fprintf(stdout, "%-10s %10.1f %10.1f %10.1f\n", "searched", searched_sum / queries.size(), percentile(searched_latency, .99),
+		    (double)searched_expansions / queries.size());
+	fprintf(stdout, "page 1    %10.1f expanded per query, %u queries with different pages\n", (double)first_expansions / queries.size(),
+		    (unsigned int)different);
+}
+
+template <class TAutocompleteType>
+void replay(TAutocompleteType &ac, const vector<string> &queries, const char *attribute, const bool beam, const bool interleave, const bool parallel,
+	        const unsigned int coalescing_threads, const bool paginate)
+{
+	uint64_t filter(TTrie::any_attribute);
+	if (attribute != nullptr)
+	{
+		filter = ac.index().attribute(attribute);
+		if (filter == 0)
+			fprintf(stderr, "attribute %s does not occur in dictionary\n", attribute);
+	}
+
+	vector<double> latency, first_latency;
+	latency.reserve(queries.size());
+
+	size_t expansions(0), precomputed(0);
+
+	struct rusage usage_begin, usage_end;
+	getrusage(RUSAGE_SELF, &usage_begin);
+
+	for (vector<string>::const_iterator i(queries.begin()); i != queries.end(); ++i)
+	{
+		TFirstSuggestion   handler;
+		TClock::time_point begin(TClock::now());
+		ac.autocomplete(*i, handler, 5, filter);
+		TClock::time_point end(TClock::now());
+
+		latency.push_back(elapsed_us(begin, end));
+		expansions  += ac.stats().expansions;
+		precomputed += ac.stats().precomputed;
+		if (handler.found_any)
+			first_latency.push_back(elapsed_us(begin, handler.first));
+	}
+
+	getrusage(RUSAGE_SELF, &usage_end);
+
+	double sum(.0);
+	for (vector<double>::const_iterator i(latency.begin()); i != latency.end(); ++i)
+		sum += *i;
+
+	sort(latency.begin(), latency.end());
+
+	fprintf(stdout, "queries   %10u\n",       (unsigned int)latency.size());
+	fprintf(stdout, "mean      %10.1f us\n",  sum / latency.size());
+	fprintf(stdout, "p50       %10.1f us\n",  percentile(latency, .50));
+	fprintf(stdout, "p90       %10.1f us\n",  percentile(latency, .90));
+	fprintf(stdout, "p99       %10.1f us\n",  percentile(latency, .99));
+	fprintf(stdout, "max       %10.1f us\n",  latency.back());
+	fprintf(stdout, "expanded  %10.1f per query\n", (double)expansions / latency.size());
+	fprintf(stdout, "faults    %10.2f major, %.2f minor per query\n", (double)(usage_end.ru_majflt - usage_begin.ru_majflt) / latency.size(),
+		    (double)(usage_end.ru_minflt - usage_begin.ru_minflt) / latency.size());
+	fprintf(stdout, "read      %10.1f KB per query\n", (usage_end.ru_inblock - usage_begin.ru_inblock) * 512. / 1024. / latency.size());
+	if (precomputed > 0)
+		fprintf(stdout, "answered  %10u from answer table\n", (unsigned int)precomputed);
+
+	// time to the first streamed suggestion
+	if (!first_latency.empty())
+	{
+		sort(first_latency.begin(), first_latency.end());
+		fprintf(stdout, "first p50 %10.1f us\n",  percentile(first_latency, .50));
+		fprintf(stdout, "first p99 %10.1f us\n",  percentile(first_latency, .99));
+	}
+
+	if (beam)
+		sweep_beam_width(ac, queries, filter);
+
+	if (interleave)
+		sweep_interleaving(ac, queries, filter);
+
+	if (parallel)
+		sweep_parallel(ac, queries, filter);
+
+	if (coalescing_threads > 0)
+		replay_coalescing(ac, queries, filter, coalescing_threads);
+
+	if (paginate)
+		sweep_pagination(ac, queries, filter);
+}
+
+template <class TAutocompleteType>
+void build_answer_table(TAutocompleteType &ac, const size_t length)
+{
+	TClock::time_point begin(TClock::now());
+	ac.build_answer_table(length);
+	fprintf(stdout, "answers   %10.1f ms  %.1f MB\n", elapsed_us(begin, TClock::now()) / 1000., ac.answer_table_memory() / (1024. * 1024.));
+}
+
+//
+// dictionaries searched by one search vs separate searches
+//
+int federated(const string &dictionaries, const vector<string> &queries, const TTrie::Format &format, const char *attribute, 
+	          const bool beam, const bool interleave, const bool parallel, const unsigned int coalescing_threads, const bool paginate, const bool typos,
+			  const size_t answer_length)
+{
+	TFederatedAutocomplete ac;
+	vector<string>         files;
+
+	TClock::time_point begin(TClock::now());
+	size_t             bytes(0);
+	for (size_t start(0); start <= dictionaries.size();)
+	{
+		size_t end(dictionaries.find(',', start));
+		if (end == string::npos)
+			end = dictionaries.size();
+
+		string file(dictionaries.substr(start, end - start));
+		float  prior(1.);
+
+		size_t colon(file.rfind(':'));
+		if (colon != string::npos)
+		{
+			prior = (float)atof(file.substr(colon + 1).c_str());
+			file.resize(colon);
+		}
+
+		bytes += ac.load(file, file, prior, format);
+		files.push_back(file);
+
+		start = end + 1;
+	}
+
+	double load_ms(elapsed_us(begin, TClock::now()) / 1000.);
+	fprintf(stdout, "load      %10.1f ms  %.1f MB/s\n", load_ms, bytes / (1024. * 1024.) / (load_ms / 1000.));
+	fprintf(stdout, "dicts     %10u\n", (unsigned int)files.size());
+
+	if (typos)
+		ac.build_typo_index();
+
+	if (answer_length > 0)
+		build_answer_table(ac, answer_length);
+
+	replay(ac, queries, attribute, beam, interleave, parallel, coalescing_threads, paginate);
+
+	// the same queries searched in every dictionary separately
+	size_t expansions(0);
+	double elapsed(.0);
+	for (vector<string>::const_iterator i(files.begin()); i != files.end(); ++i)
+	{
+		if (attribute != nullptr && *i != attribute)  // dictionary filtered out
+			continue;
+
+		TAutocomplete separate;
+		separate.load(*i, format);
+		if (typos)
+			separate.build_typo_index();
+
+		vector<string> suggestions;
+		for (vector<string>::const_iterator q(queries.begin()); q != queries.end(); ++q)
+		{
+			begin = TClock::now();
+			separate.autocomplete(*q, suggestions);
+			elapsed += elapsed_us(begin, TClock::now());
+
+			expansions += separate.stats().expansions;
+		}
+	}
+	fprintf(stdout, "separate  %10.1f us  %.1f expanded per query\n", elapsed / queries.size(), (double)expansions / queries.size());
+
+	return 0;
+}
+
+//
+// suggestions and scores of compile time error model and keyboard policies vs the same model evaluated at run time
+//
+void compare_reference(TAutocomplete &ac, TReferenceAutocomplete &reference, const vector<string> &queries, const char *attribute)
+{
+	const size_t max_suggestions(5);
+	const size_t listed(10);  // differing queries printed
+
+	const uint64_t filter(attribute != nullptr ? ac.index().attribute(attribute) : TTrie::any_attribute);
+
+	fprintf(stdout, "\nquery\n   %-30s %-12s %-30s %s\n", "policies", "score", "runtime", "score");
+
+	double policies_us(.0), runtime_us(.0), max_difference(.0);
+	size_t different_suggestions(0), different_scores(0);
+	for (vector<string>::const_iterator i(queries.begin()); i != queries.end(); ++i)
+	{
+		TScoredSuggestions expected, found;
+
+		TClock::time_point begin(TClock::now());
+		reference.autocomplete(*i, expected, max_suggestions, filter);
+		runtime_us += elapsed_us(begin, TClock::now());
+
+		begin = TClock::now();
+		ac.autocomplete(*i, found, max_suggestions, filter);
+		policies_us += elapsed_us(begin, TClock::now());
+
+		if (found.suggestions == expected.suggestions)
+		{
+			double difference(.0);
+			for (size_t k(0); k < found.scores.size(); ++k)
+				difference = std::max(difference, std::fabs((double)found.scores[k] - expected.scores[k]) / expected.scores[k]);
+
+			max_difference    = std::max(max_difference, difference);
+			different_scores += difference > .0;
+			if (difference == .0)
+				continue;
+		}
+		else
+			++different_suggestions;
+
+		if (different_suggestions + different_scores > listed)
+			continue;
+
+		fprintf(stdout, "%s\n", i->c_str());
+		for (size_t k(0); k < std::max(found.suggestions.size(), expected.suggestions.size()); ++k)
+			fprintf(stdout, "   %-30s %-12g %-30s %g\n", k < found.suggestions.size() ? found.suggestions[k].c_str() : "-",
+				    k < found.scores.size() ? found.scores[k] : .0f, k < expected.suggestions.size() ? expected.suggestions[k].c_str() : "-",
+				    k < expected.scores.size() ? expected.scores[k] : .0f);
+	}
+
+	fprintf(stdout, "\n%-10s %10s\n", "model", "mean us");
+	fprintf(stdout, "%-10s %10.1f\n", "policies", policies_us / queries.size());
+	fprintf(stdout, "%-10s %10.1f\n", "runtime", runtime_us / queries.size());
+	fprintf(stdout, "different %10u suggestions, %u scores (max relative difference %g)\n", (unsigned int)different_suggestions,
+		    (unsigned int)different_scores, max_difference);
+}
+
+int main(int argc, char* argv[])
+{
+	TTrie::Format format;
+	if (argc > 2 && string(argv[1]) == "-c")
+	{
+		if (sscanf(argv[2], "%u,%u,%u", &format.word_column, &format.weight_column, &format.attribute_column) < 2)
+		{
+			fprintf(stderr, "invalid column mapping %s\n", argv[2]);
+			return 1;
+		}
+
+		format.delimiter      = ',';
+		format.default_weight = 1.;
+		format.header         = true;
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	const char *attribute(nullptr);
+	if (argc > 2 && string(argv[1]) == "-f")
+	{
+		attribute = argv[2];
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc > 1 && string(argv[1]) == "-u")
+	{
+		format.fold_case = true;
+
+		--argc;
+		++argv;
+	}
+
+	bool minimize(false), louds(false), art(false), paged(false);
+	if (argc > 1 && (string(argv[1]) == "-m" || string(argv[1]) == "-l" || string(argv[1]) == "-r"))
+	{
+		minimize = argv[1][1] == 'm';
+		louds    = argv[1][1] == 'l';
+		art      = argv[1][1] == 'r';
+
+		--argc;
+		++argv;
+	}
+
+	size_t pinned_mb(0);
+	if (!minimize && !louds && !art && argc > 2 && string(argv[1]) == "-p")
+	{
+		paged     = true;
+		pinned_mb = (size_t)atoi(argv[2]);
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	bool beam(false);
+	if (argc > 1 && string(argv[1]) == "-b")
+	{
+		beam = true;
+
+		--argc;
+		++argv;
+	}
+
+	bool interleave(false);
+	if (argc > 1 && string(argv[1]) == "-i")
+	{
+		interleave = true;
+
+		--argc;
+		++argv;
+	}
+
+	bool parallel(false);
+	if (argc > 1 && string(argv[1]) == "-j")
+	{
+		parallel = true;
+
+		--argc;
+		++argv;
+	}
+
+	unsigned int coalescing_threads(0);
+	if (argc > 2 && string(argv[1]) == "-k")
+	{
+		coalescing_threads = (unsigned int)atoi(argv[2]);
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	bool paginate(false);
+	if (argc > 1 && string(argv[1]) == "-g")
+	{
+		paginate = true;
+
+		--argc;
+		++argv;
+	}
+
+	bool typos(false);
+	if (argc > 1 && string(argv[1]) == "-s")
+	{
+		typos = true;
+
+		--argc;
+		++argv;
+	}
+
+	size_t answer_length(0);
+	if (argc > 2 && string(argv[1]) == "-a")
+	{
+		answer_length = (size_t)atoi(argv[2]);
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	bool reference(false);
+	if (argc > 1 && string(argv[1]) == "-e")
+	{
+		reference = true;
+
+		--argc;
+		++argv;
+	}
+
+	if (argc < 3 || ((louds || paged) && argc > 3))
+	{
+		fprintf(stderr, "usage: replay [-c word_column,weight_column[,attribute_column] [-f attribute]] [-u] [-m | -l | -r | -p pinned_mb] [-b] [-i] [-j] [-k threads] [-g] [-s] [-a length] [-e] dictionary query_log [training_log]\n");
+		return 1;
+	}
+
+	vector<string> queries;
+	read_queries(argv[2], queries);
+	if (queries.empty())
+	{
+		fprintf(stderr, "no queries in %s\n", argv[2]);
+		return 1;
+	}
+
+	if (string(argv[1]).find(',') != string::npos)
+	{
+		if (louds || minimize || art || paged || argc > 3)
+		{
+			fprintf(stderr, "several dictionaries can not be combined with -m, -l, -r, -p or training log\n");
+			return 1;
+		}
+
+		return federated(argv[1], queries, format, attribute, beam, interleave, parallel, coalescing_threads, paginate, typos, answer_length);
+	}
+
+	TClock::time_point begin(TClock::now());
+
+	if (louds)
+	{
+		TLoudsAutocomplete ac;
+
+		size_t bytes(ac.load(argv[1], format));
+		double load_ms(elapsed_us(begin, TClock::now()) / 1000.);
+		fprintf(stdout, "load      %10.1f ms  %.1f MB/s\n", load_ms, bytes / (1024. * 1024.) / (load_ms / 1000.));
+		fprintf(stdout, "nodes     %10u\n", (unsigned int)ac.index().size());
+		fprintf(stdout, "topology  %10.2f bits/node\n", ac.index().topology_memory() * 8. / ac.index().size());
+		fprintf(stdout, "memory    %10.1f MB\n", ac.index().memory() / (1024. * 1024.));
+
+		if (typos)
+			ac.build_typo_index();
+
+		if (answer_length > 0)
+			build_answer_table(ac, answer_length);
+
+		replay(ac, queries, attribute, beam, interleave, parallel, coalescing_threads, paginate);
+		return 0;
+	}
+
+	if (paged)
+	{
+		// cold start: index pages are dropped from page cache
+		int fd(open(argv[1], O_RDONLY));
+		if (fd >= 0)
+		{
+			fdatasync(fd);
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+
+		TPagedAutocomplete ac;
+		ac.open(argv[1]);
+		fprintf(stdout, "index     %10.1f MB  %u pages of %u bytes\n", ac.index().memory() / (1024. * 1024.), (unsigned int)ac.index().pages(),
+			    (unsigned int)ac.index().page_size());
+
+		if (pinned_mb > 0)
+		{
+			try
+			{
+				begin = TClock::now();
+				size_t pinned(ac.pin(pinned_mb * 1024 * 1024));
+				fprintf(stdout, "pinned    %10.1f MB  %.1f ms\n", pinned / (1024. * 1024.), elapsed_us(begin, TClock::now()) / 1000.);
+			}
+			catch (const std::exception &e)
+			{
+				fprintf(stderr, "%s\n", e.what());
+			}
+		}
+
+		if (typos)
+			ac.build_typo_index();
+
+		if (answer_length > 0)
+			build_answer_table(ac, answer_length);
+
+		replay(ac, queries, attribute, beam, interleave, parallel, coalescing_threads, paginate);
+		return 0;
+	}
+
+	if (art)
+	{
+		TArtAutocomplete ac;
+
+		size_t bytes(ac.load(argv[1], format));
+		double load_ms(elapsed_us(begin, TClock::now()) / 1000.);
+		fprintf(stdout, "load      %10.1f ms  %.1f MB/s\n", load_ms, bytes / (1024. * 1024.) / (load_ms / 1000.));
+		fprintf(stdout, "nodes     %10u  %u small, %u medium, %u large\n", (unsigned int)ac.index().size(), 
+			    (unsigned int)ac.index().nodes_of_kind(TArtTrie::small), (unsigned int)ac.index().nodes_of_kind(TArtTrie::medium),
+			    (unsigned int)ac.index().nodes_of_kind(TArtTrie::large));
+		fprintf(stdout, "memory    %10.1f MB\n", ac.index().memory() / (1024. * 1024.));
+
+		if (typos)
+			ac.build_typo_index();
+
+		if (answer_length > 0)
+			build_answer_table(ac, answer_length);
+
+		replay(ac, queries, attribute, beam, interleave, parallel, coalescing_threads, paginate);
+		return 0;
+	}
+
+	TAutocomplete ac;
+
+	size_t bytes(ac.load(argv[1], format));
+	double load_ms(elapsed_us(begin, TClock::now()) / 1000.);
+	fprintf(stdout, "load      %10.1f ms  %.1f MB/s\n", load_ms, bytes / (1024. * 1024.) / (load_ms / 1000.));
+	fprintf(stdout, "nodes     %10u\n", (unsigned int)ac.index().size());
+	if (format.fold_case)
+		fprintf(stdout, "folded    %10u words displayed in upper case spelling\n", (unsigned int)ac.index().display_forms().size());
+
+	if (minimize)
+	{
+		const size_t nodes(ac.index().size()), memory(ac.index().memory());
+
+		begin = TClock::now();
+		ac.minimize();
+		fprintf(stdout, "minimize  %10.1f ms  %u -> %u nodes, %.1f -> %.1f MB\n", elapsed_us(begin, TClock::now()) / 1000.,
+			    (unsigned int)nodes, (unsigned int)ac.index().size(), memory / (1024. * 1024.), ac.index().memory() / (1024. * 1024.));
+	}
+
+	if (typos)
+	{
+		begin = TClock::now();
+		ac.build_typo_index();
+		fprintf(stdout, "typos     %10.1f ms\n", elapsed_us(begin, TClock::now()) / 1000.);
+	}
+
+	if (argc > 3)
+	{
+		begin = TClock::now();
+		ac.relayout(string(argv[3]));
+		fprintf(stdout, "relayout  %10.1f ms\n", elapsed_us(begin, TClock::now()) / 1000.);
+	}
+
+	if (answer_length > 0)
+		build_answer_table(ac, answer_length);
+
+	if (reference)
+	{
+		TReferenceAutocomplete runtime;
+		runtime.load(argv[1], format);
+		if (typos)
+			runtime.build_typo_index();
+
+		compare_reference(ac, runtime, queries, attribute);
+	}
+
+	replay(ac, queries, attribute, beam, interleave, parallel, coalescing_threads, paginate);
+
+	return 0;
+}
@@ -6,6 +6,8 @@
 #include "mongoose.h"
 
 extern const char* complete(const char* s);
+extern const char* metrics_text();
+extern int degraded();
 
 bool exit_flag = false;
 
@@ -23,16 +25,28 @@ static void *callback(
         const char* answer = buffer;
         const char* request = (0 == *(request_info->uri) ? "" : request_info->uri + 1);
         const char* content = "text/html";
+        const char* flags = "";
 
-        answer = complete(request);
-        content = "application/json";
+        if (strcmp(request, "metrics") == 0)
+        {
+            answer = metrics_text();
+            content = "text/plain; version=0.0.4";
+        }
+        else
+        {
+            answer = complete(request);
+            content = "application/json";
+            if (degraded())
+                flags = "X-Autocomplete-Degraded: 1\r\n";  // search was cut short under load
+        }
 
         mg_printf(conn,
             "HTTP/1.1 200 OK\r\n"
             "Content-Type: %s\r\n"
+            "%s"
             "Content-Length: %d\r\n"
             "\r\n"
-            "%s\r\n", content, strlen(answer)+2, answer);
+            "%s\r\n", content, flags, strlen(answer)+2, answer);
 
         return (void *)"";  // Mark as processed
     }
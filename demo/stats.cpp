@@ -0,0 +1,170 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//
+// reports shape and memory of dictionary trie for capacity planning
+//    usage: stats [-c word_column,weight_column[,attribute_column]] [-u] [-m] [-v] dictionary
+//       - dictionary can be gzip compressed; -c reads it as CSV with header (see replay)
+//       - with -u dictionary is case folded (TTrie::Format::fold_case) - spellings of a word share nodes
+//       - with -m trie is minimized before the report (TTrie::minimize)
+//       - with -v alternative layouts are built and their memory is reported next to the estimates
+//
+
+#include <cstdio>
+
+#include "AutocompleteUtils.h"
+#include "LoudsTrie.h"
+#include "ArtTrie.h"
+
+double mb(const size_t bytes)
+{
+	return bytes / (1024. * 1024.);
+}
+
+void row(const char *name, const size_t bytes, const size_t total, const size_t nodes)
+{
+	fprintf(stdout, "  %-18s %10.1f MB %6.1f%% %8.1f B/node\n", name, mb(bytes), 100. * bytes / total, (double)bytes / nodes);
+}
+
+int main(int argc, char* argv[])
+{
+	TTrie::Format format;
+	if (argc > 2 && string(argv[1]) == "-c")
+	{
+		if (sscanf(argv[2], "%u,%u,%u", &format.word_column, &format.weight_column, &format.attribute_column) < 2)
+		{
+			fprintf(stderr, "invalid column mapping %s\n", argv[2]);
+			return 1;
+		}
+
+		format.delimiter      = ',';
+		format.default_weight = 1.;
+		format.header         = true;
+
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc > 1 && string(argv[1]) == "-u")
+	{
+		format.fold_case = true;
+
+		--argc;
+		++argv;
+	}
+
+	bool minimize(false);
+	if (argc > 1 && string(argv[1]) == "-m")
+	{
+		minimize = true;
+
+		--argc;
+		++argv;
+	}
+
+	bool verify(false);
+	if (argc > 1 && string(argv[1]) == "-v")
+	{
+		verify = true;
+
+		--argc;
+		++argv;
+	}
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: stats [-c word_column,weight_column[,attribute_column]] [-u] [-m] [-v] dictionary\n");
+		return 1;
+	}
+
+	TTrie trie;
+	const size_t bytes(trie.load(argv[1], format));
+	if (minimize)
+		trie.minimize();
+
+	const TTrieStats stats(trie.stats());
+	const size_t     memory(trie.memory());
+
+	fprintf(stdout, "dictionary %10.1f MB\n", mb(bytes));
+	fprintf(stdout, "nodes      %10u stored, %u in tree\n", (unsigned int)stats.nodes, (unsigned int)stats.tree_nodes);
+	fprintf(stdout, "words      %10u\n", (unsigned int)stats.terminals);
+	if (format.fold_case)
+		fprintf(stdout, "folded     %10u words displayed in upper case spelling, %.1f MB\n", (unsigned int)trie.display_forms().size(),
+			    mb(trie.display_forms().memory()));
+	fprintf(stdout, "chains     %10u single subtree paths with %u nodes (%.1f%% of tree)\n",
+		    (unsigned int)stats.chains, (unsigned int)stats.chain_nodes, 100. * stats.chain_nodes / stats.tree_nodes);
+
+	fprintf(stdout, "\nmemory%s\n", minimize ? " (minimized)" : "");
+	row("labels",        stats.label_bytes,       memory, stats.nodes);
+	row("probabilities", stats.probability_bytes, memory, stats.nodes);
+	row("attributes",    stats.attribute_bytes,   memory, stats.nodes);
+	row("child lists",   stats.child_list_bytes,  memory, stats.nodes);
+	row("padding",       stats.padding_bytes,     memory, stats.nodes);
+	row("total",         memory,                  memory, stats.nodes);
+
+	fprintf(stdout, "\nlayouts    %10s %10s %8s\n", "estimate", "measured", "vs TTrie");
+
+	size_t minimized_measured(0), louds_measured(0), art_measured(0);
+	if (verify)
+	{
+		TLoudsTrie louds;
+		louds.build(trie);
+		louds_measured = louds.memory();
+
+		TArtTrie art;
+		art.build(trie);
+		art_measured = art.memory();
+
+		if (minimize)
+			minimized_measured = memory;
+		else
+		{
+			TTrie minimized(trie);
+			minimized.minimize();
+			minimized_measured = minimized.memory();
+		}
+	}
+
+	const size_t estimates[] = {memory, stats.minimized_bytes, stats.louds_bytes, stats.art_bytes};
+	const size_t measured[]  = {memory, minimized_measured, louds_measured, art_measured};
+	const char  *names[]     = {"TTrie", "minimized", "TLoudsTrie", "TArtTrie"};
+	for (size_t i(0); i < 4; ++i)
+	{
+		fprintf(stdout, "%-10s %8.1f MB ", names[i], mb(estimates[i]));
+		if (measured[i] > 0)
+			fprintf(stdout, "%7.1f MB ", mb(measured[i]));
+		else
+			fprintf(stdout, "%10s ", "-");
+		fprintf(stdout, "%7.2fx\n", (double)estimates[i] / memory);
+	}
+
+	fprintf(stdout, "\n%-6s %10s %10s   nodes by number of subtrees\n", "depth", "nodes", "words");
+	fprintf(stdout, "%-6s %10s %10s  ", "", "", "");
+	const char *buckets[TTrieStats::n_fanout_buckets] = {"0", "1", "2", "3", "4", "5-8", "9-16", "17-32", "33+"};
+	for (size_t b(0); b < TTrieStats::n_fanout_buckets; ++b)
+		fprintf(stdout, " %8s", buckets[b]);
+	fprintf(stdout, "\n");
+
+	for (size_t d(0); d < stats.depths.size(); ++d)
+	{
+		fprintf(stdout, "%-6u %10u %10u  ", (unsigned int)d, (unsigned int)stats.depths[d], (unsigned int)(d < stats.lengths.size() ? stats.lengths[d] : 0));
+		for (size_t b(0); b < TTrieStats::n_fanout_buckets; ++b)
+			fprintf(stdout, " %8u", (unsigned int)stats.fanout[d][b]);
+		fprintf(stdout, "\n");
+	}
+
+	return 0;
+}
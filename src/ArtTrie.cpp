@@ -0,0 +1,138 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ArtTrie.h"
+
+#include <stdexcept>
+using std::runtime_error;
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const size_t label_padding = 16;  // medium nodes read labels in blocks of 16
+
+TArtTrie::TArtTrie()
+{
+}
+
+void TArtTrie::build(const TTrie &trie)
+{
+	nodes.clear();
+	labels.clear();
+	maps.clear();
+	masks.clear();
+
+	attribute_names = trie.attribute_values();
+	forms           = trie.display_forms();
+
+	vector<size_t> level_order(1, 0);  // TTrie nodes in level order - used as BFS queue
+
+	for (size_t i(0); i < level_order.size(); ++i)
+	{
+		const TTrie::Node &node(trie.node(level_order[i]));
+
+		if (level_order.size() + node.sub_trees.size() > 0xffffffffu)  // ids are stored in 32 bits
+			throw runtime_error("TArtTrie::build - too many nodes");
+
+		TNode n;
+		n.prob        = node.prob;
+		n.first       = (uint32_t)level_order.size();
+		n.keys        = 0;
+		n.n_sub_trees = (uint16_t)node.sub_trees.size();
+		n.c           = node.c;
+
+		if (node.sub_trees.size() <= max_small)
+		{
+			n.kind = small;
+			for (size_t k(0); k < node.sub_trees.size(); ++k)
+				n.keys |= (uint32_t)(unsigned char)trie.node(node.sub_trees[k]).c << (8 * k);
+		}
+		else
+		if (node.sub_trees.size() <= max_medium)
+			n.kind = medium;
+		else
+		{
+			n.kind = large;
+			n.keys = (uint32_t)(maps.size() / 256);
+
+			maps.resize(maps.size() + 256, 0);
+			for (size_t k(0); k < node.sub_trees.size(); ++k)
+				maps[n.keys * 256 + (unsigned char)trie.node(node.sub_trees[k]).c] = (uint16_t)(k + 1);
+		}
+
+		nodes.push_back(n);
+		labels.push_back(node.c);
+		if (!attribute_names.empty())  // attribute masks are stored only for dictionaries with attributes
+			masks.push_back(trie.attributes(level_order[i]));
+
+		level_order.insert(level_order.end(), node.sub_trees.begin(), node.sub_trees.end());
+	}
+
+	labels.resize(labels.size() + label_padding, (char)0);
+
+	vector<TNode>(nodes).swap(nodes);
+	vector<char>(labels).swap(labels);
+	vector<uint16_t>(maps).swap(maps);
+	vector<uint64_t>(masks).swap(masks);
+}
+
+TArtTrie::TSubTreeIt TArtTrie::find_wide(const TNodeRef node, const char c) const
+{
+	if (node->kind == large)
+	{
+		const uint16_t position(maps[node->keys * 256 + (unsigned char)c]);
+		return TSubTreeIt(position == 0 ? node->first + node->n_sub_trees : node->first + position - 1);
+	}
+
+	const char *sub_trees(&labels[node->first]);
+#ifdef __SSE2__
+	unsigned int hits(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(c), _mm_loadu_si128((const __m128i *)sub_trees))));
+	hits &= (1u << node->n_sub_trees) - 1;  // labels of the following nodes are ignored
+
+	return TSubTreeIt(hits == 0 ? node->first + node->n_sub_trees : node->first + ctz(hits));
+#else
+	size_t k(0);
+	while (k < node->n_sub_trees && sub_trees[k] != c)
+		++k;
+
+	return TSubTreeIt(node->first + k);
+#endif
+}
+
+uint64_t TArtTrie::attribute(const string &value) const
+{
+	for (size_t i(0); i < attribute_names.size(); ++i)
+		if (attribute_names[i] == value)
+			return (uint64_t)1 << i;
+
+	return 0;
+}
+
+size_t TArtTrie::nodes_of_kind(const TKind kind) const
+{
+	size_t n(0);
+	for (vector<TNode>::const_iterator i(nodes.begin()); i != nodes.end(); ++i)
+		n += i->kind == kind;
+
+	return n;
+}
+
+size_t TArtTrie::memory() const
+{
+	return nodes.capacity() * sizeof(TNode) + labels.capacity() * sizeof(char) + maps.capacity() * sizeof(uint16_t) +
+		   masks.capacity() * sizeof(uint64_t) + forms.memory();
+}
@@ -0,0 +1,141 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+using std::vector;
+
+#include "AutocompleteUtils.h"
+
+//
+//  TArtTrie
+//    - read-only encoding of TTrie with adaptive node kinds (in the style of adaptive radix tree)
+//    - nodes are numbered in level order; subtrees of a node are consecutive nodes in TTrie order (by probability),
+//      so search iterates them without child pointers
+//    - node kind depends on number of subtrees and selects child lookup by label (find):
+//        small  (up to 4)   - labels of subtrees are inline in the node
+//        medium (up to 16)  - packed labels of subtrees are compared at once (SSE2)
+//        large              - 256 entry map from label to subtree
+//    - 16 bytes per node and one byte per label, attribute masks only if dictionary has attributes
+//
+
+class TArtTrie
+{
+    public:
+
+		TArtTrie();
+
+		void build(const TTrie &trie);  // trie can be minimized - shared subtries are expanded
+
+		enum TKind {small, medium, large};
+
+		static const size_t max_small  = 4;
+		static const size_t max_medium = 16;
+
+		struct TNode
+		{
+			float    prob;
+			uint32_t first;   // id of the first subtree
+			uint32_t keys;    // small: byte k is label of subtree k; large: index of label map
+			uint16_t n_sub_trees;
+			char     c;
+			uint8_t  kind;
+		};
+
+		class TSubTreeIt  // iterates over consecutive subtree ids
+		{
+		    public:
+				TSubTreeIt(const size_t id = 0)
+					: id(id) {}
+
+				size_t      operator*() const                         { return id; }
+				TSubTreeIt& operator++()                              { ++id; return *this; }
+				bool        operator==(const TSubTreeIt &rhs) const   { return id == rhs.id; }
+				bool        operator!=(const TSubTreeIt &rhs) const   { return id != rhs.id; }
+
+		    private:
+				size_t id;
+		};
+
+		// node access used by TBasicAutocomplete
+		typedef const TNode *TNodeRef;
+
+		TNodeRef ref(const size_t index) const      { return &nodes[index]; };
+		size_t   index(const TNodeRef node) const   { return node - &nodes[0]; };
+
+		size_t   roots() const              { return 1; };
+		size_t   root(const size_t) const   { return 0; };
+
+		char     label(const size_t index) const      { return labels[index]; };
+		float    prob(const size_t index) const       { return nodes[index].prob; };
+		uint64_t attributes(const size_t index) const { return masks.empty() ? 0 : masks[index]; };
+		float    prob(const size_t index, const uint64_t) const { return prob(index); };  // no bounds per attribute
+
+		static char       label(const TNodeRef node) { return node->c; };
+		static float      prob(const TNodeRef node)  { return node->prob; };
+		static TSubTreeIt begin(const TNodeRef node) { return TSubTreeIt(node->first); };
+		static TSubTreeIt end(const TNodeRef node)   { return TSubTreeIt(node->first + node->n_sub_trees); };
+
+		// node will be expanded soon (interleaved search) - fetch its subtrees (up to 4 cache lines of nodes)
+		void prefetch(const TNodeRef node) const
+		{
+			const TNode *sub_trees(&nodes[0] + node->first);
+			const size_t n(node->n_sub_trees < 16 ? node->n_sub_trees : 16);
+			for (size_t k(0); k < n; k += 4)
+				prefetch_memory(sub_trees + k);
+
+			prefetch_memory(&labels[node->first]);
+			if (!masks.empty())
+				prefetch_memory(&masks[node->first]);
+		}
+
+		// subtree of node with label; end(node) if there is none
+		TSubTreeIt find(const TNodeRef node, const char c) const
+		{
+			if (node->kind != small)
+				return find_wide(node, c);
+
+			// bytes of keys equal to c are 0; the lowest 0 byte is found without branches
+			const uint32_t x(node->keys ^ (0x01010101u * (unsigned char)c));
+			uint32_t       hits((x - 0x01010101u) & ~x & 0x80808080u);
+			hits &= (uint32_t)(((uint64_t)1 << (8 * node->n_sub_trees)) - 1);  // bytes of subtrees
+
+			return TSubTreeIt(hits == 0 ? node->first + node->n_sub_trees : node->first + ctz(hits) / 8);
+		}
+
+		size_t size() const { return nodes.size(); };
+
+		uint64_t attribute(const string &value) const;  // see TTrie::attribute
+
+		void display(const TNodeRef, string &word) const { forms.display(word); };  // see TTrie::display
+
+		size_t nodes_of_kind(const TKind kind) const;
+		size_t memory() const;  // bytes
+
+    private:
+
+		TSubTreeIt find_wide(const TNodeRef node, const char c) const;  // medium and large nodes
+
+		vector<TNode>    nodes;
+		vector<char>     labels;  // label of every node; subtrees of a node are consecutive
+		vector<uint16_t> maps;    // 256 entries per large node: position of subtree with label + 1; 0 -> no subtree
+		vector<uint64_t> masks;   // attributes of nodes
+		vector<string>   attribute_names;
+		TDisplayForms    forms;
+};
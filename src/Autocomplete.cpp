@@ -7,27 +7,91 @@ using std::runtime_error;
 #include <algorithm>
 using std::find;
 
-void TAutocomplete::autocomplete(const string         &query,  
+#include <fstream>
+using std::ifstream;
+
+#include <cmath>
+
+#include <exception>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+template <class TIndex, class TModel, class TLayout>
+TBasicAutocomplete<TIndex, TModel, TLayout>::TBasicAutocomplete()
+	: node_hits(nullptr), beam_width(0), parallel_threads(0), parallel_expansions(0), typo_prefix_length(0)
+{
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::autocomplete(const string         &query,  
 	                                   vector<string> &suggestions,
-						         const size_t         max_suggestions)
+						         const size_t         max_suggestions,
+								 const uint64_t       filter)
 {
 	suggestions.clear(); 
 
+	search_stats = TSearchStats();
+	complete(query, suggestions, max_suggestions, nullptr, filter, search_stats);
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::autocomplete(const string             &query,  
+	                                                TSuggestionHandler &handler,
+						                      const size_t             max_suggestions,
+								              const uint64_t           filter)
+{
+	vector<string> suggestions;  // suggestions found so far - needed to filter out duplicates
+
+	search_stats = TSearchStats();
+	complete(query, suggestions, max_suggestions, &handler, filter, search_stats);
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::autocomplete(const string             &query,  
+	                                                TSuggestionHandler &handler,
+						                      const size_t             max_suggestions,
+								              const uint64_t           filter,
+											        TSearchStats       &stats,
+											  const unsigned int       budget) const
+{
+	vector<string> suggestions;
+
+	stats = TSearchStats();
+	complete(query, suggestions, max_suggestions, &handler, filter, stats, budget);
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::complete(const string             &query,  
+	                                            vector<string>     &suggestions,
+						                  const size_t             max_suggestions,
+								                TSuggestionHandler *handler,
+								          const uint64_t           filter,
+										        TSearchStats       &stats,
+										  const unsigned int       budget) const
+{
+	if (!admits_root(filter))  // no word has filter attributes
+		return;
+
 	string::const_iterator begin(query.begin());
 	string::const_iterator end(query.end());
 	while (begin != end && *begin == ' ')
 		++begin;
 
-	if (begin != end)
-		autocomplete(begin, end, suggestions, max_suggestions);
+	if (begin != end && !precomputed(begin, end, suggestions, max_suggestions, handler, filter, stats))
+		autocomplete(begin, end, suggestions, max_suggestions, handler, stats, filter, budget);
 }
 
-bool goal(const TCandidate              &candidate,
+template <class TIndex>
+bool goal(const TIndex                  &index,
+          const TBasicCandidate<TIndex> &candidate,
           const string::const_iterator  &query_end, 
 		        float                   &min_suggestion_prob,
                 vector<string>          &suggestions)
 {
-	if (candidate.node->sub_trees.size() > 0)  // leaf has no subtrees
+	if (TIndex::begin(candidate.node) != TIndex::end(candidate.node))  // leaf has no subtrees
 		return false;
 
     if (candidate.query != query_end)  // query must be already matched at trie leaf
@@ -35,6 +99,7 @@ bool goal(const TCandidate              &candidate,
 
 	// remove string delimiter in trie
 	string suggestion(candidate.suggestion.substr(0, candidate.suggestion.size() - 1));
+	index.display(candidate.node, suggestion);  // spelling of word in case folded dictionary
 	// no duplicates in results allowed
 	if (find(suggestions.begin(), suggestions.end(), suggestion) == suggestions.end())
 	{
@@ -52,35 +117,428 @@ bool goal(const TCandidate              &candidate,
 //
 // perform autocomplete using best-first search over trie
 //
-void TAutocomplete::autocomplete(const string::const_iterator  &query_begin, 
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::autocomplete(const string::const_iterator  &query_begin, 
 			                     const string::const_iterator  &query_end, 
 						               vector<string>          &suggestions,
-						         const size_t                   max_suggestions)
+						         const size_t                   max_suggestions,
+								       TSuggestionHandler      *handler,
+									   TSearchStats            &stats,
+								 const uint64_t                &filter,
+								 const unsigned int             budget) const
 { 
+   if (beam_width > 0)
+   {
+	   beam_search(query_begin, query_end, suggestions, max_suggestions, handler, stats, filter, budget);
+	   return;
+   }
+
    TCandidates candidates;
+   start(candidates, query_begin, query_end, filter);
+
+   search(candidates, query_begin, query_end, suggestions, max_suggestions, handler, stats, filter, budget);
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::start(      TCandidates             &candidates,
+	                                   const string::const_iterator  &query_begin, 
+			                           const string::const_iterator  &query_end, 
+									   const uint64_t                &filter) const
+{
+   for (size_t root(0); root < trie.roots(); ++root)
+	   if (admits(trie.root(root), filter))
+		   candidates.push(TCandidate(trie.ref(trie.root(root)),  // start at the trie root(s)
+							 		  query_begin,                // at the beginning of the user query
+							 		  "",                         // with empty suggestion
+									  (float)1.,                  // with all probability mass assigned to empty query
+									  0));                        // and no typing errors so far
+
+   vector<TCandidate> seeds;  // typos in the first characters
+   seed(query_begin, query_end, seeds, filter);
+   for (typename vector<TCandidate>::const_iterator i(seeds.begin()); i != seeds.end(); ++i)
+	   candidates.push(*i);
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::search(      TCandidates             &candidates,
+	                                    const string::const_iterator  &query_begin, 
+			                            const string::const_iterator  &query_end, 
+						                      vector<string>          &suggestions,
+						                const size_t                   max_suggestions,
+								              TSuggestionHandler      *handler,
+											  TSearchStats            &stats,
+											  const uint64_t          &filter,
+											  const unsigned int       budget) const
+{ 
+   if (candidates.empty())
+	   return;
+
+   TSearch search(query_begin, query_end, suggestions, max_suggestions, handler, stats, filter);
+   search.budget = budget;
+   search.candidates.swap(candidates);
+
+   while (step(search))
+	   if (parallel_threads > 1 && search.stats->expansions >= parallel_expansions && search.min_suggestion_prob > (float).0 &&
+		   budget == 0 && !node_hits)  // expensive query with a suggestion (see parallel_search)
+	   {
+		   parallel_search(search);
+		   break;
+	   }
+}
 
-   candidates.push(TCandidate(trie.root(),     // start at the trie root
-					 		  query_begin,     // at the beginning of the user query
-					 		  "",              // with empty suggestion
-							  (float)1.,       // with all probability mass assigned to empty query
-							  0));             // and no typing errors so far
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::step(TSearch &search) const
+{
+   TCandidate candidate(search.candidates.top());	  
+   search.candidates.pop();
+
+   if (search.parallel)  // bound raised by suggestions of other threads
+	   search.min_suggestion_prob = std::max(search.min_suggestion_prob, search.parallel->bound.load(std::memory_order_relaxed));
+
+   if (candidate.probability < search.min_suggestion_prob)  // no probable candidates left
+   {
+	   search.finished = true;
+	   return false;
+   }
 
-   float    min_suggestion_prob((float).0);    // min probability of acceptable candidate
-   unsigned int iteration(0);
+   if (search.min_suggestion_prob == (float).0 && ++search.iteration > 10000)  // no solution found in first 10000 iterations
+   {
+	   search.stats->iteration_cap = true;
+	   search.finished             = true;
+	   return false;  
+   }
+
+   if (search.budget > 0 && search.stats->expansions >= search.budget)  // search is cut short under load
+   {
+	   search.stats->degraded = true;
+	   search.finished        = true;
+	   return false;
+   }
 
-   do
+   size_t n_suggestions(search.suggestions->size());
+   if ( ! goal(trie, candidate, search.end, search.min_suggestion_prob, *search.suggestions) ) 
    {
-	   TCandidate candidate(candidates.top());	  
-	   candidates.pop();
+	   if (node_hits)
+		   trace(candidate);
+
+	   expand(candidate, search.candidates, search.begin, search.end, search.min_suggestion_prob, search.filter);
+
+	   ++search.stats->expansions;
+	   if (search.candidates.size() > search.stats->frontier_peak)
+		   search.stats->frontier_peak = (unsigned int)search.candidates.size();
+   }
+   else
+   if (search.suggestions->size() > n_suggestions)
+   {
+	   if (search.parallel)
+		   search.parallel->found(search.suggestions->back(), candidate.probability);
+
+	   if (search.handler && !search.handler->found(search.suggestions->back(), candidate.probability))
+		   return false;  // consumer has enough suggestions
+   }
+
+   return search.candidates.size() > 0 && search.suggestions->size() < search.max_suggestions;
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::autocomplete(const string             &query,
+	                                                                 TSuggestionHandler &handler,
+															   const size_t             max_suggestions,
+															   const uint64_t           filter,
+															         TSearchStats       &stats,
+																	 TContinuation      &continuation) const
+{
+	continuation.query  = query;
+	continuation.offset = std::min(query.find_first_not_of(' '), query.size());
+	continuation.filter = filter;
+	continuation.found.clear();
+	continuation.candidates          = TCandidates();
+	continuation.min_suggestion_prob = (float).0;
+	continuation.iteration           = 0;
+	continuation.done                = true;
+
+	stats = TSearchStats();
+
+	const string::const_iterator begin(continuation.query.begin() + continuation.offset), end(continuation.query.end());
+	if (begin == end || !admits_root(filter))
+		return;
 
-	   if (candidate.probability < min_suggestion_prob ||              // no probable candidates left
-           (min_suggestion_prob == (float).0 && ++iteration > 10000))  // no solution found in first 10000 iterations
-		   break;  
+	if (beam_width > 0)
+		beam(continuation.candidates, begin, end, stats, filter);
+	else
+		start(continuation.candidates, begin, end, filter);
 
-	   if ( ! goal(candidate, query_end, min_suggestion_prob, suggestions) ) 
-		   expand(candidate, candidates, query_begin, query_end, min_suggestion_prob);
+	continuation.done = false;
+	advance(continuation, handler, max_suggestions, stats);
+}
 
-   } while (candidates.size() > 0 && suggestions.size() < max_suggestions);
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::resume(TContinuation      &continuation,
+	                                                           TSuggestionHandler &handler,
+														 const size_t             max_suggestions,
+														       TSearchStats       &stats) const
+{
+	stats = TSearchStats();
+	advance(continuation, handler, max_suggestions, stats);
+}
+
+// the search continues as one search for all suggestions found so far and max_suggestions more would
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::advance(TContinuation      &continuation,
+	                                                            TSuggestionHandler &handler,
+														  const size_t             max_suggestions,
+														        TSearchStats       &stats) const
+{
+	if (continuation.done || max_suggestions == 0)
+		return;
+
+	TSearch search(continuation.query.begin() + continuation.offset, continuation.query.end(), continuation.found,
+		           continuation.found.size() + max_suggestions, &handler, stats, continuation.filter);
+	search.candidates.swap(continuation.candidates);
+	search.min_suggestion_prob = continuation.min_suggestion_prob;
+	search.iteration           = continuation.iteration;
+
+	while (!search.candidates.empty() && step(search))
+		;
+
+	continuation.candidates.swap(search.candidates);
+	continuation.min_suggestion_prob = search.min_suggestion_prob;
+	continuation.iteration           = search.iteration;
+	continuation.done                = search.finished || continuation.candidates.empty();
+}
+
+template <class TIndex, class TModel, class TLayout>
+struct TBasicAutocomplete<TIndex, TModel, TLayout>::TParallel
+{
+	TParallel(const size_t needed, const float bound)
+		: needed(needed), bound(bound) {}
+
+	// distinct suggestions are kept in descending order of score, equal scores in order of suggestion, so the merge does
+	// not depend on timing of threads; the bound is raised to the score of the needed-th suggestion - candidates below it
+	// can not make it to the results
+	void found(const string &suggestion, const float &score)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		for (vector<pair<float, string> >::iterator i(suggestions.begin()); i != suggestions.end(); ++i)
+			if (i->second == suggestion)  // found by another thread with a different correction
+			{
+				if (i->first >= score)
+					return;
+
+				suggestions.erase(i);
+				break;
+			}
+
+		vector<pair<float, string> >::iterator position(suggestions.begin());
+		while (position != suggestions.end() && (position->first > score || (position->first == score && position->second < suggestion)))
+			++position;
+		suggestions.insert(position, pair<float, string>(score, suggestion));
+
+		if (suggestions.size() >= needed)
+			bound.store(std::max(bound.load(std::memory_order_relaxed), suggestions[needed - 1].first), std::memory_order_relaxed);
+	}
+
+	const size_t                  needed;      // suggestions to be found by threads
+	std::mutex                    lock;
+	vector<pair<float, string> >  suggestions; // found by threads: score, suggestion
+	std::atomic<float>            bound;       // min probability of acceptable candidate
+};
+
+//
+// frontier of expensive query is dealt in order of probability among threads, so that each gets its share of the
+// most promising candidates; threads search their candidates best-first and merged suggestions are streamed by score
+//    - search is split after the first suggestion: the iteration cap (see step) decides which candidates are expanded
+//      only before it, so threads expand all candidates above the bound as single thread search would
+//    - threads stop at the bound, not at a number of their own suggestions, so that all suggestions scored equal to
+//      the last one are found; suggestions of equal score are ordered by suggestion (single thread search keeps them in
+//      order of expansion, so they can be ordered differently)
+//
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::parallel_search(TSearch &search) const
+{
+	const size_t n_threads(std::min((size_t)parallel_threads, search.candidates.size()));
+	if (n_threads < 2)
+	{
+		while (step(search))
+			;
+		return;
+	}
+
+	TParallel parallel(search.max_suggestions - search.suggestions->size(), search.min_suggestion_prob);
+
+	vector<vector<string> > suggestions(n_threads, *search.suggestions);  // suggestions found so far are not repeated
+	vector<TSearchStats>    stats(n_threads);
+	vector<TSearch>         searches;
+	for (size_t k(0); k < n_threads; ++k)
+	{
+		searches.push_back(TSearch(search.begin, search.end, suggestions[k], ~(size_t)0, nullptr, stats[k], search.filter));
+		searches.back().min_suggestion_prob = search.min_suggestion_prob;
+		searches.back().parallel            = &parallel;
+	}
+
+	for (size_t k(0); !search.candidates.empty(); k = (k + 1) % n_threads)
+	{
+		searches[k].candidates.push(search.candidates.top());
+		search.candidates.pop();
+	}
+
+	workers.run(n_threads, [this, &searches](const size_t k) { while (step(searches[k])) ; });  // rethrows after all are done
+
+	unsigned int frontier(0);
+	for (size_t k(0); k < n_threads; ++k)
+	{
+		search.stats->expansions += stats[k].expansions;
+		frontier                 += stats[k].frontier_peak;
+	}
+	search.stats->frontier_peak = std::max(search.stats->frontier_peak, frontier);
+
+	for (size_t i(0); i < parallel.suggestions.size() && i < parallel.needed; ++i)
+	{
+		search.suggestions->push_back(parallel.suggestions[i].second);
+		if (search.handler && !search.handler->found(parallel.suggestions[i].second, parallel.suggestions[i].first))
+			break;
+	}
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::set_parallel(const unsigned int n_threads, const size_t min_expansions)
+{
+	parallel_threads    = n_threads;
+	parallel_expansions = min_expansions;
+
+	workers.start(n_threads > 1 ? n_threads - 1 : 0);
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::autocomplete(const vector<string>         &queries,
+	                                                                 vector<vector<string> > &suggestions,
+	                                                                 vector<TSearchStats>    &stats,
+															   const size_t                  max_suggestions,
+															   const uint64_t                filter,
+															   const size_t                  width) const
+{
+	suggestions.assign(queries.size(), vector<string>());
+	stats.assign(queries.size(), TSearchStats());
+
+	vector<TSearch> searches;  // interleaved searches
+	size_t          next(0);   // next query to start
+
+	while (next < queries.size() || !searches.empty())
+	{
+		while (searches.size() < std::max((size_t)1, width) && next < queries.size())
+		{
+			const size_t i(next++);
+			if (!admits_root(filter))
+				continue;
+
+			string::const_iterator begin(queries[i].begin());
+			string::const_iterator end(queries[i].end());
+			while (begin != end && *begin == ' ')
+				++begin;
+
+			if (begin == end || precomputed(begin, end, suggestions[i], max_suggestions, nullptr, filter, stats[i]))
+				continue;
+
+			if (beam_width > 0)
+			{
+				beam_search(begin, end, suggestions[i], max_suggestions, nullptr, stats[i], filter);
+				continue;
+			}
+
+			searches.push_back(TSearch(begin, end, suggestions[i], max_suggestions, nullptr, stats[i], filter));
+			start(searches.back().candidates, begin, end, filter);
+
+			if (searches.back().candidates.empty())
+				searches.pop_back();
+			else
+				trie.prefetch(searches.back().candidates.top().node);
+		}
+
+		// one expansion of every search; the next one is prefetched while the other searches are expanded
+		for (size_t k(0); k < searches.size();)
+			if (step(searches[k]))
+				trie.prefetch(searches[k++].candidates.top().node);
+			else
+			{
+				std::swap(searches[k], searches.back());
+				searches.pop_back();
+			}
+	}
+}
+
+//
+// beam search: query is matched position by position keeping only beam_width best candidates per position;
+// candidates that matched the whole query are completed by best-first search
+//
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::beam_search(const string::const_iterator  &query_begin, 
+			                                 const string::const_iterator  &query_end, 
+						                           vector<string>          &suggestions,
+						                     const size_t                   max_suggestions,
+								                   TSuggestionHandler      *handler,
+												   TSearchStats            &stats,
+												   const uint64_t          &filter,
+												   const unsigned int       budget) const
+{
+	TCandidates candidates;
+	beam(candidates, query_begin, query_end, stats, filter);
+
+	search(candidates, query_begin, query_end, suggestions, max_suggestions, handler, stats, filter, budget);
+}
+
+// candidates of beam search that matched the whole query - they are completed by best-first search
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::beam(      TCandidates             &candidates,
+	                                  const string::const_iterator  &query_begin, 
+			                          const string::const_iterator  &query_end, 
+									        TSearchStats            &stats,
+									  const uint64_t                &filter) const
+{
+	vector<TCandidates> beams(query_end - query_begin + 1);  // candidates by query position
+
+	for (size_t root(0); root < trie.roots(); ++root)
+		if (admits(trie.root(root), filter))
+			beams[0].push(TCandidate(trie.ref(trie.root(root)), query_begin, "", (float)1., 0));
+
+	vector<TCandidate> seeds;
+	seed(query_begin, query_end, seeds, filter);
+	for (typename vector<TCandidate>::const_iterator i(seeds.begin()); i != seeds.end(); ++i)
+		beams[i->query - query_begin].push(*i);
+
+	for (size_t position(0); position + 1 < beams.size(); ++position)
+	{
+		for (size_t n(0); n < beam_width && !beams[position].empty(); ++n)
+		{
+			TCandidate candidate(beams[position].top());
+			beams[position].pop();
+
+			if (node_hits)
+				trace(candidate);
+
+			// all successors of candidate; insertions stay at the same position
+			TStep step(candidate, keyboard, query_begin);
+			for (TAction action(candidate.begin); action != candidate.end; ++action)
+			{
+				float      best_left, best_right;
+				TCandidate successor(candidate);
+				successor.probability = (float).0;
+
+				if (expand_action(candidate, action, step, query_begin, query_end, best_left, successor, best_right, filter))
+					beams[successor.query - query_begin].push(successor);
+			}
+
+			++stats.expansions;
+		}
+
+		beams[position] = TCandidates();  // release candidates outside of the beam
+	}
+
+	for (size_t n(0); n < beam_width && !beams.back().empty(); ++n)
+	{
+		candidates.push(beams.back().top());
+		beams.back().pop();
+	}
 }
 
 
@@ -90,15 +548,17 @@ void TAutocomplete::autocomplete(const string::const_iterator  &query_begin,
 // general all possible corrections of current candidate
 //    - all one edit operations on current query candidate are considered
 //
-void TAutocomplete::expand(const TCandidate                &candidate, 
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::expand(const TCandidate                &candidate, 
 	                             TCandidates               &candidates, 
 						   const string::const_iterator    &query_begin,
 				           const string::const_iterator    &query_end,
-						   const float                     &min_prob)
+						   const float                     &min_prob,
+						   const uint64_t                  &filter) const
 {
 	if (candidate.query == query_end)  // query is alreay matched to trie interior node
 	{
-       	expand_matched_query(candidate, candidates);
+       	expand_matched_query(candidate, candidates, filter);
 		return;
 	}
 
@@ -108,37 +568,47 @@ void TAutocomplete::expand(const TCandidate                &candidate,
 	float best_left, best_right;           // max probability among left/right subtrees of the best node 
 	TAction best_action(candidate.begin);  // max probability candidate successor action 
 
-	split(candidate, query_begin, query_end, best_left, best, best_right, best_action);
+	split(candidate, query_begin, query_end, best_left, best, best_right, best_action, filter);
 	add_candidates(candidates, candidate, min_prob, best_left, best, best_right, best_action);
 }
 
-void TAutocomplete::expand_matched_query(const TCandidate  &candidate, 
-	                                           TCandidates &candidates) 
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::expand_matched_query(const TCandidate  &candidate, 
+	                                           TCandidates &candidates,
+	                                     const uint64_t    &filter) const
 {
 	// emulate depth first trie traversal as the most promising leaf is in the left subtree
 	if (candidate.begin != candidate.end)
 	{
 		TAction action(candidate.begin);
-		TTrie::Node &first(trie.node(*action.sub_tree));
+		while (!admits(*action.sub_tree, filter))  // skip subtrees without filter attributes
+			if (++action == candidate.end || action.operation != candidate.begin.operation)
+				return;
+
+		TNodeRef first(trie.ref(*action.sub_tree));
 
 		candidates.push(TCandidate(first,                            // advance in trie via sub_tree
-			                       TAction(first, TAction::no_correction, first.sub_trees.begin()),
-			                       TAction(first, TAction::no_correction, first.sub_trees.end()),
+			                       TAction(first, TAction::no_correction, TIndex::begin(first)),
+			                       TAction(first, TAction::no_correction, TIndex::end(first)),
 							       candidate.query,                          // query stays the same as it is already matched
-			                       candidate.suggestion + first.c,           // add current node character to candidate suggestion
+			                       candidate.suggestion + TIndex::label(first),  // add current node character to candidate suggestion
 							       candidate.query_probability,              // query probability stays the same since query is already matched
-								   candidate.query_probability * first.prob, // update candidate probability 
+								   candidate.query_probability * bound(*action.sub_tree, filter), // update candidate probability 
 							       candidate.n_errors));                     // number of errors stays the same since query is already matched
 
-		TAction::operation_t old_operation(action.operation);
-		if (++action != candidate.end && action.operation == old_operation)  // prevent rolling to the next operation -> only allow one iteration over subtrees
-			candidates.push(TCandidate(*candidate.node,                         // stay in the same node in trie
-			                           TAction(*candidate.node, TAction::no_correction, action.sub_tree),
-			                           TAction(*candidate.node, TAction::no_correction, action.node->sub_trees.end()),
+		// the rest of subtrees are estimated by the next one with filter attributes
+		typename TAction::operation_t old_operation(action.operation);
+		while (++action != candidate.end && action.operation == old_operation && !admits(*action.sub_tree, filter))
+			;
+
+		if (action != candidate.end && action.operation == old_operation)  // prevent rolling to the next operation -> only allow one iteration over subtrees
+			candidates.push(TCandidate(candidate.node,                          // stay in the same node in trie
+			                           TAction(candidate.node, TAction::no_correction, action.sub_tree),
+			                           TAction(candidate.node, TAction::no_correction, TIndex::end(action.node)),
 			                           candidate.query,                         // query stays the same as we have not  moved in trie
 							           candidate.suggestion,                    // suggestion stays the same as we have not  moved in trie
 									   candidate.query_probability,             // query probability stays the same as the query is already matched
-									   candidate.query_probability * trie.node(*action.sub_tree).prob,  // next best node is used for subtree list probability estimation
+									   candidate.query_probability * trie.prob(*action.sub_tree),  // next best node is used for subtree list probability estimation
 									   candidate.n_errors));                    // number of errors stays the same as the query is already matched
 	}
 }
@@ -179,8 +649,9 @@ Properties of error types:
 
 */
 
-void error_probabilities(const TCandidate              &candidate, 
-	                           TKeyboard               &keyboard,
+template <class TModel, class TLayout, class TIndex>
+void error_probabilities(const TBasicCandidate<TIndex> &candidate, 
+	                     const TLayout                 &keyboard,
 	                     const string::const_iterator  &query_begin,
 		                       float                   &hit_prob, 
 		                       float                   &insertion_prob, 
@@ -190,32 +661,31 @@ void error_probabilities(const TCandidate              &candidate,
 	                           float                   &deletion_prob, 
 						       float                   &transposition_prob)
 {
-	insertion_prob     = (float).16;   // 16% deletion errors -> 16% insertion prob
-    substitution_prob  = (float).17; 
-    deletion_prob      = (float).60;   // 60% insertion errors errors -> 60% deletion prob
-	transposition_prob = (float).06;  
+	insertion_prob     = TModel::insertion;
+    substitution_prob  = TModel::substitution; 
+    deletion_prob      = TModel::deletion;
+	transposition_prob = TModel::transposition;  
 
-	begin_insertion_penalty    = (float).05;
-	begin_substitution_penalty = (float).1;
+	begin_insertion_penalty    = TModel::begin_insertion_penalty;
+	begin_substitution_penalty = TModel::begin_substitution_penalty;
 
 	// insertion error less likely at the beginning of query
 	if (candidate.query == query_begin)
-		deletion_prob *= (float).05;
+		deletion_prob *= TModel::first_deletion_penalty;
 	else
 	if (candidate.query == query_begin + 1)
-		deletion_prob *= (float).1;
+		deletion_prob *= TModel::second_deletion_penalty;
 	else // insertion error usually at near keys
-		if (keyboard.distance((unsigned char)*(candidate.query), candidate.node->c) > 2)
-			deletion_prob *= (float).25;
+		if (keyboard.distance((unsigned char)*(candidate.query), TIndex::label(candidate.node)) > TModel::near_key_distance)
+			deletion_prob *= TModel::far_deletion_penalty;
 	
 	// weight with error probability per key pressed
-	const float keypress_error_prob((float).05);             // per-key pressed probability of error
-	hit_prob = (float)1.0 - keypress_error_prob;             // per-key pressed probability of entering correct key
+	hit_prob = (float)1.0 - TModel::keypress_error;             // per-key pressed probability of entering correct key
 
-	insertion_prob     *= keypress_error_prob;   
-    substitution_prob  *= keypress_error_prob; 
-    deletion_prob      *= keypress_error_prob;   
-	transposition_prob *= keypress_error_prob;  
+	insertion_prob     *= TModel::keypress_error;   
+    substitution_prob  *= TModel::keypress_error; 
+    deletion_prob      *= TModel::keypress_error;   
+	transposition_prob *= TModel::keypress_error;  
 }
 
 
@@ -223,77 +693,72 @@ void error_probabilities(const TCandidate              &candidate,
    orders candidates successor states into ordered list: [left candidates, best candidate, right candidates] 
    return best candidate and admissible probability estimate of left and right candidate sets
 */
-void TAutocomplete::split(const TCandidate              &candidate,
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::split(const TCandidate              &candidate,
 	                      const string::const_iterator  &query_begin,
 				          const string::const_iterator  &query_end,
 	                             float                  &best_left,
 	                             TCandidate             &best,
 						         float                  &best_right,
-								 TAction                &best_action)
+								 TAction                &best_action,
+								 const uint64_t         &filter) const
 {
-	// probabilities for various types of errors
-	float hit_prob, insertion_prob, substitution_prob, deletion_prob, transposition_prob;
-	float begin_insertion_penalty, begin_substitution_penalty;
-	
-	error_probabilities(candidate, keyboard, query_begin,
-		                hit_prob, 
-		                insertion_prob,    begin_insertion_penalty,
-	                    substitution_prob, begin_substitution_penalty,
-	                    deletion_prob, 
-						transposition_prob);
-
-	float sum_transition_no_correction((float).0);   // normalization factor for avancing without correction
-	float sum_transition_insert((float).0);          // normalization factor for insert characters actions
-	float sum_transition_substitute((float).0);      // normalization factor for substitute characters actions 
+	TStep step(candidate, keyboard, query_begin);
 
 	best.probability = best_left = best_right = (float).0;     
 	best_action = candidate.begin;
 
 	for (TAction action(candidate.begin); action != candidate.end; ++action)
-		switch (action.operation)
-		{
-		   case TAction::no_correction: 
-			   {
-				   if (expand_no_correction(hit_prob, sum_transition_no_correction, candidate, action, query_end, best_left, best, best_right))
-					   best_action = action;
-				   break;
-			   }
-
-           case TAction::insert_char: 
-			   {				  
-				   if (expand_substitute_char(true,  insertion_prob, sum_transition_insert, candidate, action, query_begin, query_end, begin_insertion_penalty, best_left, best, best_right))
-					   best_action = action;
-					  
-				   break;
-			   }
-
-           case TAction::substitute_char: 
-			   {				  
-				   if (expand_substitute_char(false,  substitution_prob, sum_transition_substitute, candidate, action, query_begin, query_end, begin_substitution_penalty, best_left, best, best_right))
-					   best_action = action;
-				   break;
-			   }
-
-		   case TAction::delete_char: 
-			   {
-				   if (expand_delete_char(deletion_prob, candidate, query_end, best_left, best, best_right))
-					   best_action = action;
-					
-				   break;
-			   }
-
-		   case TAction::transpose_char: 
-			   {				  				  
-				   if (expand_transpose_char(transposition_prob, candidate, query_end, best_left, best, best_right))
-					   best_action = action;
-					
-				   break;
-			   }
-
-		   default:
-			   throw std::runtime_error("illegal action in TAutocomplete::split");
-	    }
+		if (expand_action(candidate, action, step, query_begin, query_end, best_left, best, best_right, filter))
+			best_action = action;
+}
 
+template <class TIndex, class TModel, class TLayout>
+TBasicAutocomplete<TIndex, TModel, TLayout>::TStep::TStep(const TCandidate &candidate, const TLayout &keyboard, const string::const_iterator &query_begin)
+	: sum_no_correction((float).0), sum_insert((float).0), sum_substitute((float).0)
+{
+	error_probabilities<TModel>(candidate, keyboard, query_begin,
+		                hit, 
+		                insertion,    begin_insertion_penalty,
+	                    substitution, begin_substitution_penalty,
+	                    deletion, 
+						transposition);
+}
+
+//
+// successor of candidate by action; returns true if it is better than best so far
+//
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::expand_action(const TCandidate              &candidate,
+	                                                 TAction                 &action,
+													 TStep                   &step,
+	                                           const string::const_iterator  &query_begin,
+				                               const string::const_iterator  &query_end,
+	                                                 float                   &best_left,
+	                                                 TCandidate              &best,
+						                             float                   &best_right,
+						                       const uint64_t                &filter) const
+{
+	switch (action.operation)
+	{
+		case TAction::no_correction: 
+			return expand_no_correction(step.hit, step.sum_no_correction, candidate, action, query_end, best_left, best, best_right, filter);
+
+		case TAction::insert_char: 
+			return expand_substitute_char(true,  step.insertion, step.sum_insert, candidate, action, query_begin, query_end, step.begin_insertion_penalty, best_left, best, best_right, filter);
+
+		case TAction::substitute_char: 
+			return expand_substitute_char(false,  step.substitution, step.sum_substitute, candidate, action, query_begin, query_end, step.begin_substitution_penalty, best_left, best, best_right, filter);
+
+		case TAction::delete_char: 
+			return expand_delete_char(step.deletion, candidate, query_end, best_left, best, best_right);
+
+		case TAction::transpose_char: 
+			return expand_transpose_char(step.transposition, candidate, query_end, best_left, best, best_right, filter);
+
+		default:
+			throw std::runtime_error("illegal action in TAutocomplete::split");
+	}
 }
 
 
@@ -315,6 +780,7 @@ string::const_iterator next_char(string::const_iterator begin, const string::con
 	return begin;
 }
 
+template <class TCandidate>
 bool update_candidates(const TCandidate  &new_candidate,
 	                         float       &best_left,
 							 TCandidate  &best,
@@ -333,19 +799,21 @@ bool update_candidates(const TCandidate  &new_candidate,
 	return false;
 }
 
-bool TAutocomplete::expand_no_correction(const float                   &hit_prob, 
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::expand_no_correction(const float                   &hit_prob, 
 	                                           float                   &sum_transition_prob,
 	                                     const TCandidate              &candidate,
 										 const TAction                 &action,
 									     const string::const_iterator  &query_end,
 										       float                   &best_left,
 											   TCandidate              &best,
-											   float                   &best_right)
+											   float                   &best_right,
+											   const uint64_t          &filter) const
 {
 	if (sum_transition_prob == (float).0)
 	{
-		for (TTrie::Node::TSubTreeIt i(candidate.node->sub_trees.begin()); i != (candidate.node->sub_trees.end()); ++i)
-			if (keyboard.distance(trie.node(*i).c, *candidate.query) == 0) 
+		for (TSubTreeIt i(TIndex::begin(candidate.node)); i != TIndex::end(candidate.node); ++i)
+			if (keyboard.distance(trie.label(*i), *candidate.query) == 0 && admits(*i, filter)) 
 				sum_transition_prob += hit_prob;
 		
 		if (sum_transition_prob == (float).0)
@@ -355,23 +823,28 @@ bool TAutocomplete::expand_no_correction(const float                   &hit_prob
 	if (sum_transition_prob < (float).0)
 		return false;
 
-	TTrie::Node &sub_tree(trie.node(*action.sub_tree));
+	if (keyboard.distance(trie.label(*action.sub_tree), *candidate.query) == 0 && admits(*action.sub_tree, filter)) 
+	{
+		TNodeRef    sub_tree(trie.ref(*action.sub_tree));
+		const float query_probability(candidate.query_probability * hit_prob *  // query probability updated with keystroke hit rate
+									  hit_prob / sum_transition_prob);          // is normalized over all transitions in trie
 
-	if (keyboard.distance(sub_tree.c, *candidate.query) == 0) 
 		return update_candidates(TCandidate(sub_tree,                                  // advance in trie via matched subtree
          					   		        next_char(candidate.query, query_end),     // advance query as we've found a match               
-					                        candidate.suggestion + sub_tree.c,         // add matched subtree character to candidate suggestion
-							                candidate.query_probability * hit_prob *   // query probability updated with keystroke hit rate
-											hit_prob / sum_transition_prob,            // is normalized over all transitions in trie
+					                        candidate.suggestion + TIndex::label(sub_tree),  // add matched subtree character to candidate suggestion
+							                query_probability,
+							                query_probability * bound(*action.sub_tree, filter),  // by words with filter attributes
 							                candidate.n_errors),                       // number of errors stays the samae as we've found the match
                                  best_left,
 					             best,
 						         best_right);
+	}
 
 	return false;
 }
 
-bool TAutocomplete::expand_substitute_char(const bool                    &insert_char, 
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::expand_substitute_char(const bool                    &insert_char, 
 	                                       const float                   &substitution_prob, 
 										         float                   &sum_transition_prob, 
 										   const TCandidate              &candidate, 
@@ -381,16 +854,17 @@ bool TAutocomplete::expand_substitute_char(const bool                    &insert
 										   const float                   &begin_penalty,
 									             float                   &best_left, 
 												 TCandidate              &best, 
-												 float                   &best_right)
+												 float                   &best_right,
+												 const uint64_t          &filter) const
 {
 	if (sum_transition_prob == (float).0)
-		for (TTrie::Node::TSubTreeIt i(candidate.node->sub_trees.begin()); i != (candidate.node->sub_trees.end()); ++i)
+		for (TSubTreeIt i(TIndex::begin(candidate.node)); i != TIndex::end(candidate.node); ++i)
 		{
 			float prob;
 		    bool  exact_match;
 			
-			if ( transition_prob(candidate, trie.node(*i), query_begin, begin_penalty, prob, exact_match) &&
-				(insert_char || ! exact_match)) // with substitution exatch match does not count as it is already handled by expand_exact_match(...)
+			if ( transition_prob(candidate, trie.label(*i), query_begin, begin_penalty, prob, exact_match) &&
+				(insert_char || ! exact_match) && admits(*i, filter)) // with substitution exatch match does not count as it is already handled by expand_exact_match(...)
 			sum_transition_prob += prob;
 		}
 
@@ -400,49 +874,42 @@ bool TAutocomplete::expand_substitute_char(const bool                    &insert
 	float prob;
 	bool  exact_match;
 
-	TTrie::Node &succ_node(trie.node(*action.sub_tree));
-    if ( transition_prob(candidate, succ_node, query_begin, begin_penalty, prob, exact_match) &&
-		 (insert_char || ! exact_match))
+    if ( transition_prob(candidate, trie.label(*action.sub_tree), query_begin, begin_penalty, prob, exact_match) &&
+		 (insert_char || ! exact_match) && admits(*action.sub_tree, filter))
+	{
+		 TNodeRef    succ_node(trie.ref(*action.sub_tree));
+		 const float query_probability(candidate.query_probability *                    // query probability update 
+									   substitution_prob * prob / sum_transition_prob);  // is normalized over all transitions in trie
 
 		 return update_candidates(TCandidate(succ_node,                                            // advance in trie via succ_node subtree
 						  	                 insert_char ? candidate.query :                       // if char is inserted query must stary the same      
 									                next_char(candidate.query, query_end),         // if char is updated query is advanced to the next char
-							                 candidate.suggestion + succ_node.c,                   // add succ_node subtree character to candidate suggestion
-							                 candidate.query_probability *                         // query probability update 
-							                 substitution_prob * prob / sum_transition_prob,       // is normalized over all transitions in trie
+							                 candidate.suggestion + TIndex::label(succ_node),      // add succ_node subtree character to candidate suggestion
+							                 query_probability,
+							                 query_probability * bound(*action.sub_tree, filter),  // by words with filter attributes
 							                 candidate.n_errors + 1),                              // substitution increases number of errors
                                  best_left,
 					             best,
 						         best_right);
+	}
 
 	return false;
 }
 
-bool TAutocomplete::transition_prob(const TCandidate              &candidate,
-	                                 TTrie::Node                  &subtree,
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::transition_prob(const TCandidate              &candidate,
+	                                const char                    &subtree,
 					                const string::const_iterator  &query_begin,
                                     const float                   &begin_penalty,
 									      float                   &transition_prob,
-							              bool                    &exact_match)
+							              bool                    &exact_match) const
 {
-	if (subtree.c == (char)0) // leaf node -> no expansion allowed 
+	if (subtree == (char)0) // leaf node -> no expansion allowed 
 		return false;
 
-	unsigned int distance(keyboard.distance(subtree.c, *candidate.query));
+	unsigned int distance(keyboard.distance(subtree, *candidate.query));
 
-	if (distance == 0)
-		transition_prob = (float).95;
-	else
-	if (distance == 1)
-		transition_prob = (float).1;
-	else
-	if (distance < 4)
-		transition_prob = (float).05;
-	else
-	if (distance < 8)
-		transition_prob = (float).0025;
-	else
-		transition_prob = (float).00005;
+	transition_prob = TModel::transition(distance);
 
 	if (candidate.query == query_begin && distance > 0)
 		transition_prob *= begin_penalty;  // operation at the beginning of query is less likely
@@ -452,14 +919,15 @@ bool TAutocomplete::transition_prob(const TCandidate              &candidate,
 } 
 
 
-bool TAutocomplete::expand_delete_char(const float                   &deletion_prob,
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::expand_delete_char(const float                   &deletion_prob,
 	                                   const TCandidate              &candidate, 
 									   const string::const_iterator  &query_end,
 									         float                   &best_left, 
 											 TCandidate              &best, 
-											 float                   &best_right) 
+											 float                   &best_right) const 
 {
-		return update_candidates(TCandidate(*candidate.node,                              // no advance in trie
+		return update_candidates(TCandidate(candidate.node,                               // no advance in trie
 		                                    candidate.begin,
 		                                    candidate.end,
 							                next_char(candidate.query, query_end),        // delete character by advancing in user query
@@ -473,21 +941,24 @@ bool TAutocomplete::expand_delete_char(const float                   &deletion_p
 
 
 
-bool TAutocomplete::expand_transpose_char(const float                   &transposition_prob,
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::expand_transpose_char(const float                   &transposition_prob,
                                           const TCandidate              &candidate, 
 								          const string::const_iterator  &query_end,
 										        float                   &best_left, 
 											    TCandidate              &best, 
-											    float                   &best_right) 
+											    float                   &best_right,
+											    const uint64_t          &filter) const
 {
 
-	TTrie::Node *transposition_end(nullptr);
+	TNodeRef transposition_end;
 	string transposition;
-	if (transpose(candidate, query_end, transposition, &transposition_end))
-		return update_candidates(TCandidate(*transposition_end,                                // advance to the node after transposition
+	if (transpose(candidate, query_end, transposition, transposition_end, filter))
+		return update_candidates(TCandidate(transposition_end,                                 // advance to the node after transposition
 							                next_char(candidate.query + 1, query_end),         // skip two query characters because of transposition
 			                                candidate.suggestion + transposition,              // add transposition to suggestion
 							                candidate.query_probability * transposition_prob,  // query probability is updated
+							                candidate.query_probability * transposition_prob * bound(trie.index(transposition_end), filter),
 							                candidate.n_errors + 1),                           // transposition adds one more error
                                  best_left,
 					             best,
@@ -498,28 +969,30 @@ bool TAutocomplete::expand_transpose_char(const float                   &transpo
 
 
 
-bool TAutocomplete::transpose(const TCandidate              &candidate, 
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::transpose(const TCandidate              &candidate, 
 	                          const string::const_iterator  &query_end,
 							        string                  &transposition,
-                                    TTrie::Node             **transposition_end)
+                                    TNodeRef                &transposition_end,
+                              const uint64_t                &filter) const
 {
 	if (candidate.query + 1 == query_end)
 		return false;
 
 	// the next query character must match one of the subtrees
 	char next_char(*(candidate.query + 1));
-	for (TTrie::Node::TSubTreeIt i(candidate.node->sub_trees.begin()); i != candidate.node->sub_trees.end(); ++i)
+	for (TSubTreeIt i(TIndex::begin(candidate.node)); i != TIndex::end(candidate.node); ++i)
 	{
-		TTrie::Node &subtree(trie.node(*i));
-		if (keyboard.distance(next_char, subtree.c) == 0)
+		if (keyboard.distance(next_char, trie.label(*i)) == 0 && admits(*i, filter))
 		{
-			for (TTrie::Node::TSubTreeIt i(subtree.sub_trees.begin()); i != subtree.sub_trees.end(); ++i)
+			TNodeRef subtree(trie.ref(*i));
+			for (TSubTreeIt i(TIndex::begin(subtree)); i != TIndex::end(subtree); ++i)
 			{
-				*transposition_end = &trie.node(*i);
-				if (keyboard.distance(*candidate.query, (*transposition_end)->c) == 0)
+				if (keyboard.distance(*candidate.query, trie.label(*i)) == 0 && admits(*i, filter))
 				{
-					transposition  = subtree.c;
-					transposition += (*transposition_end)->c;
+					transposition_end = trie.ref(*i);
+					transposition     = TIndex::label(subtree);
+					transposition    += TIndex::label(transposition_end);
 					return true;
 				}
 			}
@@ -532,13 +1005,14 @@ bool TAutocomplete::transpose(const TCandidate              &candidate,
 }
 
 
-void TAutocomplete::add_candidates(      TCandidates &candidates, 
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::add_candidates(      TCandidates &candidates, 
 	                               const TCandidate  &candidate, 
 					               const float       &min_prob, 
 					               const float       &best_left, 
 					               const TCandidate  &best, 
 					               const float       &best_right, 
-					                     TAction     &best_action)
+					                     TAction     &best_action) const
 {
 	if (best.probability > min_prob)
 	{ 
@@ -547,7 +1021,7 @@ void TAutocomplete::add_candidates(      TCandidates &candidates,
 
 		// left subtree
 		if (best_left > min_prob)
-			candidates.push(TCandidate(*candidate.node,                // no advance in trie
+			candidates.push(TCandidate(candidate.node,                 // no advance in trie
 		                               candidate.begin,                // expand from leftmost action
 									   best_action,                    // until best action
 									   candidate.query,                // query stays the same
@@ -558,7 +1032,7 @@ void TAutocomplete::add_candidates(      TCandidates &candidates,
 
 		// right subtree
 		if (best_right > min_prob)
-			candidates.push(TCandidate(*candidate.node,                // no advance in trie
+			candidates.push(TCandidate(candidate.node,                 // no advance in trie
 		                               ++best_action,                  // expand from after best action
 									   candidate.end,                  // until end
 									   candidate.query,                // query stays the same
@@ -569,7 +1043,789 @@ void TAutocomplete::add_candidates(      TCandidates &candidates,
 	}
 }
 
-void TAutocomplete::load(const string &file_name)
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::build_typo_index(const size_t prefix_length)
+{
+	if (prefix_length < 2)
+		throw runtime_error("TAutocomplete::build_typo_index - prefix length must be at least 2");
+
+	typo_prefixes.clear();
+	typo_index.clear();
+	typo_prefix_length = prefix_length;
+
+	answers = TAnswerTable();  // seeds change suggestions
+
+	// depth first traversal of trie up to prefix length
+	vector<pair<size_t, string> > stack;
+	for (size_t root(0); root < trie.roots(); ++root)
+		stack.push_back(std::make_pair(trie.root(root), string()));
+	while (!stack.empty())
+	{
+		size_t node(stack.back().first);
+		string prefix(stack.back().second);
+		stack.pop_back();
+
+		if (prefix.size() == prefix_length)
+		{
+			const size_t entry(typo_prefixes.size());
+			typo_prefixes.push_back(std::make_pair(node, prefix));
+
+			string key;
+			fold_case(prefix, key);  // as query prefix in seed(...)
+
+			typo_index[key].push_back(entry);
+			for (size_t i(0); i < key.size(); ++i)
+			{
+				vector<size_t> &entries(typo_index[string(key).erase(i, 1)]);
+				if (entries.empty() || entries.back() != entry)  // deletions of repeated characters are equal
+					entries.push_back(entry);
+			}
+
+			continue;
+		}
+
+		TNodeRef ref(trie.ref(node));
+		for (TSubTreeIt i(TIndex::begin(ref)); i != TIndex::end(ref); ++i)
+			if (trie.label(*i) != (char)0)  // words shorter than prefix are not indexed
+				stack.push_back(std::make_pair((size_t)*i, prefix + trie.label(*i)));
+	}
+}
+
+//
+// candidates at trie nodes within one edit of the first query characters; only if they are not a prefix in trie
+//    - one edit is certain in that case, so error at the beginning of query is not penalized as in error_probabilities(...)
+//
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::seed(const string::const_iterator  &query_begin, 
+			                          const string::const_iterator  &query_end, 
+									        vector<TCandidate>      &seeds,
+									  const uint64_t                &filter) const
+{
+	const size_t length(typo_prefix_length);
+	if (typo_index.empty() || (size_t)(query_end - query_begin) < length)
+		return;
+
+	// first characters of query in trie
+	for (size_t root(0); root < trie.roots(); ++root)
+	{
+		TNodeRef node(trie.ref(trie.root(root)));
+		size_t   matched(0);
+		for (string::const_iterator q(query_begin); matched < length; ++q, ++matched)
+		{
+			TSubTreeIt i(TIndex::begin(node));
+			while (i != TIndex::end(node) && (keyboard.distance(trie.label(*i), *q) != 0 || !admits(*i, filter)))
+				++i;
+
+			if (i == TIndex::end(node))
+				break;
+
+			node = trie.ref(*i);
+		}
+
+		if (matched == length)
+			return;
+	}
+
+	string prefix;
+	fold_case(string(query_begin, query_begin + length), prefix);  // keys of typo index are in lower case
+
+	const float error(TModel::keypress_error), hit(1.f - error);  // per key pressed, see error_probabilities(...)
+
+	// substituted or transposed character: deletions of query and word prefix are equal
+	for (size_t i(0); i < length; ++i)
+		seed(string(prefix).erase(i, 1), length, std::pow(hit, (float)(length - 1)) * error * TModel::substitution, query_begin, seeds, filter);
+
+	// inserted character: deletion of longer query prefix is word prefix
+	if ((size_t)(query_end - query_begin) > length)
+	{
+		string longer;
+		fold_case(prefix + *(query_begin + length), longer);
+		for (size_t i(0); i < longer.size(); ++i)
+			seed(string(longer).erase(i, 1), length + 1, std::pow(hit, (float)length) * error * TModel::deletion, query_begin, seeds, filter);
+	}
+
+	// missing character: shorter query prefix is deletion of word prefix
+	seed(prefix.substr(0, length - 1), length - 1, std::pow(hit, (float)(length - 2)) * error * TModel::insertion, query_begin, seeds, filter);
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::seed(const string                  &key,
+	                                  const size_t                  &consumed,
+									  const float                   &query_probability,
+									  const string::const_iterator  &query_begin,
+									        vector<TCandidate>      &seeds,
+									  const uint64_t                &filter) const
+{
+	typename unordered_map<string, vector<size_t> >::const_iterator entries(typo_index.find(key));
+	if (entries == typo_index.end())
+		return;
+
+	for (vector<size_t>::const_iterator i(entries->second.begin()); i != entries->second.end(); ++i)
+	{
+		const size_t node(typo_prefixes[*i].first);
+		if (!admits(node, filter))
+			continue;
+
+		bool seeded(false);
+		for (typename vector<TCandidate>::const_iterator j(seeds.begin()); j != seeds.end() && !seeded; ++j)
+			seeded = trie.index(j->node) == node && j->query == query_begin + consumed;
+
+		if (!seeded)
+			seeds.push_back(TCandidate(trie.ref(node), query_begin + consumed, typo_prefixes[*i].second, query_probability, 1));
+	}
+}
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::trie_changed()
+{
+	answers = TAnswerTable();
+
+	if (typo_index.empty())
+		typo_prefixes.clear();
+	else
+		build_typo_index(typo_prefix_length);
+}
+
+template <class TIndex, class TModel, class TLayout>
+TBasicAutocomplete<TIndex, TModel, TLayout>::TAnswerTable::TAnswerTable()
+	: alphabet_size(0), max_length(0), max_suggestions(0), beam_width(0)
+{
+	std::fill(rank, rank + 256, 0);
+}
+
+// queries are numbered as numbers in bijective base alphabet_size + 1 (query characters are digits, the first one
+// is the least significant)
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::TAnswerTable::key(const string::const_iterator  &begin, 
+	                                               const string::const_iterator  &end, 
+												         size_t                  &key) const
+{
+	if ((size_t)(end - begin) > max_length)
+		return false;
+
+	key = 0;
+	for (string::const_iterator i(end); i != begin;)
+	{
+		const unsigned char r(rank[(unsigned char)*--i]);
+		if (r == 0)
+			return false;
+
+		key = key * (alphabet_size + 1) + r;
+	}
+
+	return true;
+}
+
+// collects suggestions of answer table with their scores
+class TAnswers : public TSuggestionHandler
+{
+    public:
+		bool found(const string &suggestion, const float &score)
+		{
+			answers.push_back(std::make_pair(suggestion, score));
+			return true;
+		}
+
+		vector<pair<string, float> > answers;
+};
+
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::build_answer_table(const size_t max_length, const size_t max_suggestions, const unsigned int n_threads)
+{
+	answers = TAnswerTable();
+
+	TAnswerTable table;
+	for (size_t i(0); i < trie.size(); ++i)
+		if (trie.label(i) != (char)0 && table.rank[(unsigned char)trie.label(i)] == 0)
+			table.rank[(unsigned char)trie.label(i)] = (unsigned char)++table.alphabet_size;
+
+	table.max_length      = max_length;
+	table.max_suggestions = max_suggestions;
+	table.beam_width      = beam_width;
+
+	size_t n_keys(1);
+	for (size_t i(0); i < max_length; ++i)
+	{
+		n_keys *= table.alphabet_size + 1;
+		if (n_keys > ((size_t)1 << 24))
+			throw runtime_error("TAutocomplete::build_answer_table - too many queries, reduce max length");
+	}
+
+	vector<unsigned char> alphabet(table.alphabet_size + 1);
+	for (unsigned int c(0); c < 256; ++c)
+		alphabet[table.rank[c]] = (unsigned char)c;
+
+	// every key is a query of at most max_length characters; key 0 is the empty query
+	vector<TAnswers> results(n_keys);
+	std::atomic<size_t> next(1);
+
+	auto worker = [&]()
+	{
+		for (size_t k(next++); k < n_keys; k = next++)
+		{
+			string query;
+			for (size_t key(k); key > 0; key /= table.alphabet_size + 1)
+				query += (char)alphabet[key % (table.alphabet_size + 1)];
+
+			if (query[0] == ' ')  // leading spaces are stripped from queries
+				continue;
+
+			const uint64_t filter(TTrie::any_attribute);
+			TSearchStats   stats;
+			vector<string> suggestions;
+			autocomplete(query.begin(), query.end(), suggestions, max_suggestions, &results[k], stats, filter);
+		}
+	};
+
+	vector<std::thread> threads(n_threads > 0 ? n_threads : std::max(1u, std::thread::hardware_concurrency()));
+	for (vector<std::thread>::iterator i(threads.begin()); i != threads.end(); ++i)
+		*i = std::thread(worker);
+	for (vector<std::thread>::iterator i(threads.begin()); i != threads.end(); ++i)
+		i->join();
+
+	table.queries.reserve(n_keys + 1);
+	for (size_t k(0); k < n_keys; ++k)
+	{
+		table.queries.push_back((uint32_t)table.suggestions.size());
+		for (vector<pair<string, float> >::const_iterator i(results[k].answers.begin()); i != results[k].answers.end(); ++i)
+		{
+			table.suggestions.push_back((uint32_t)table.text.size());
+			table.scores.push_back(i->second);
+
+			table.text += i->first;
+			table.text += '\0';
+		}
+	}
+	table.queries.push_back((uint32_t)table.suggestions.size());
+
+	answers = table;
+}
+
+template <class TIndex, class TModel, class TLayout>
+size_t TBasicAutocomplete<TIndex, TModel, TLayout>::answer_table_memory() const
+{
+	return answers.queries.size() * sizeof(uint32_t) + answers.suggestions.size() * sizeof(uint32_t) + answers.scores.size() * sizeof(float) +
+		   answers.text.size();
+}
+
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::precomputed(const string::const_iterator  &begin, 
+	                                         const string::const_iterator  &end, 
+									               vector<string>          &suggestions,
+										     const size_t                   max_suggestions,
+											       TSuggestionHandler      *handler,
+											 const uint64_t                &filter,
+											       TSearchStats            &stats) const
+{
+	size_t key;
+	if (filter != TTrie::any_attribute || node_hits || max_suggestions > answers.max_suggestions || beam_width != answers.beam_width || 
+		!answers.key(begin, end, key))
+		return false;
+
+	// search returns the first max_suggestions of max_suggestions + n suggestions in the same order
+	for (uint32_t i(answers.queries[key]); i < answers.queries[key + 1] && suggestions.size() < max_suggestions; ++i)
+	{
+		suggestions.push_back(string(&answers.text[answers.suggestions[i]]));
+		if (handler && !handler->found(suggestions.back(), answers.scores[i]))
+			break;
+	}
+
+	stats.precomputed = true;
+	return true;
+}
+
+template <class TIndex, class TModel, class TLayout>
+bool TBasicAutocomplete<TIndex, TModel, TLayout>::admits_root(const uint64_t &filter) const
+{
+	for (size_t root(0); root < trie.roots(); ++root)
+		if (admits(trie.root(root), filter))
+			return true;
+
+	return false;
+}
+
+//
+// count expanded node and its subtrees as they are all accessed by split(..., filter)
+//
+template <class TIndex, class TModel, class TLayout>
+void TBasicAutocomplete<TIndex, TModel, TLayout>::trace(const TCandidate &candidate) const
+{
+	++(*node_hits)[trie.index(candidate.node)];
+
+	for (TSubTreeIt i(TIndex::begin(candidate.node)); i != TIndex::end(candidate.node); ++i)
+		++(*node_hits)[*i];
+}
+
+template class TBasicAutocomplete<TTrie>;
+template class TBasicAutocomplete<TLoudsTrie>;
+template class TBasicAutocomplete<TArtTrie>;
+template class TBasicAutocomplete<TPagedTrie>;
+template class TBasicAutocomplete<TFederatedTrie>;
+template class TBasicAutocomplete<TTrie, TReferenceErrors, TReferenceKeyboard>;
+
+
+size_t TAutocomplete::load(const string &file_name, const TTrie::Format &format)
+{
+	const size_t bytes(trie.load(file_name, format));
+	trie_changed();
+
+	return bytes;
+}
+
+void TAutocomplete::minimize()
 {
-	trie.load(file_name);
+	trie.minimize();
+	trie_changed();
+}
+
+void TAutocomplete::relayout(const vector<string> &queries)
+{
+	vector<unsigned int> hits(trie.size(), 0);
+	vector<string>       suggestions;
+
+	node_hits = &hits;
+	try
+	{
+		for (vector<string>::const_iterator i(queries.begin()); i != queries.end(); ++i)
+			autocomplete(*i, suggestions);
+	}
+	catch (...)
+	{
+		node_hits = nullptr;
+		throw;
+	}
+	node_hits = nullptr;
+
+	trie.reorder(hits);
+	trie_changed();
+}
+
+void TAutocomplete::relayout(const string &query_log_file_name)
+{
+	ifstream f(query_log_file_name.c_str());
+	if (!f)
+		throw runtime_error("TAutocomplete::relayout - cannot open file " + query_log_file_name);
+
+	vector<string> queries;
+	string         query;
+	while (getline(f, query))
+	{
+		if (!query.empty() && query[query.size() - 1] == '\r')  // for unix
+			query.resize(query.size() - 1);
+
+		if (!query.empty())
+			queries.push_back(query);
+	}
+
+	relayout(queries);
+}
+
+
+size_t TReferenceAutocomplete::load(const string &file_name, const TTrie::Format &format)
+{
+	const size_t bytes(trie.load(file_name, format));
+	trie_changed();
+
+	return bytes;
+}
+
+
+size_t TLoudsAutocomplete::load(const string &file_name, const TTrie::Format &format)
+{
+	TTrie  dictionary;
+	size_t bytes(dictionary.load(file_name, format));
+
+	trie.build(dictionary);
+	trie_changed();
+
+	return bytes;
+}
+
+
+size_t TArtAutocomplete::load(const string &file_name, const TTrie::Format &format)
+{
+	TTrie  dictionary;
+	size_t bytes(dictionary.load(file_name, format));
+
+	trie.build(dictionary);
+	trie_changed();
+
+	return bytes;
+}
+
+
+size_t TPagedAutocomplete::build(const string &file_name, const string &index_file_name, const TTrie::Format &format, const size_t page_size)
+{
+	TTrie  dictionary;
+	size_t bytes(dictionary.load(file_name, format));
+
+	TPagedTrie::write(dictionary, index_file_name, page_size);
+	return bytes;
+}
+
+void TPagedAutocomplete::open(const string &index_file_name)
+{
+	trie.open(index_file_name);
+	trie_changed();
+}
+
+size_t TPagedAutocomplete::pin(const size_t bytes)
+{
+	return trie.pin(bytes);
+}
+
+
+size_t TFederatedAutocomplete::load(const string &name, const string &file_name, const float prior, const TTrie::Format &format)
+{
+	const size_t bytes(trie.load(name, file_name, prior, format));
+	trie_changed();
+
+	return bytes;
+}
+
+
+template <class TAutocompleteType>
+struct TCoalescing<TAutocompleteType>::TFlight
+{
+	TFlight()
+		: done(false), waiting(0) {}
+
+	vector<string>          suggestions;
+	vector<float>           scores;
+	TSearchStats            stats;     // set when search is done
+	std::exception_ptr      error;     // search failed; rethrown in every request
+	bool                    done;
+	size_t                  waiting;   // requests that take suggestions; they leave when their handler stops, the last one releases flight
+	std::condition_variable found;     // suggestion found or search done
+};
+
+// passes suggestions of search on to handler of the first request while it accepts them and to waiting requests; search
+// stops when neither the first request nor any waiting one takes more suggestions
+template <class TAutocompleteType>
+class TCoalescing<TAutocompleteType>::TStream : public TSuggestionHandler
+{
+    public:
+		TStream(TCoalescing &coalescing, const string &key, TFlight &flight, TSuggestionHandler &handler)
+			: coalescing(coalescing), key(key), flight(flight), handler(handler), accepts(true) {}
+
+		std::exception_ptr error;  // thrown by handler
+
+		virtual bool found(const string &suggestion, const float &score)
+		{
+			{
+				std::lock_guard<std::mutex> guard(coalescing.lock);
+
+				flight.suggestions.push_back(suggestion);
+				flight.scores.push_back(score);
+				flight.found.notify_all();
+			}
+
+			try
+			{
+				accepts = accepts && handler.found(suggestion, score);
+			}
+			catch (...)  // handler error is of the first request only - search goes on for waiting ones
+			{
+				error   = std::current_exception();
+				accepts = false;
+			}
+
+			if (accepts)
+				return true;
+
+			std::lock_guard<std::mutex> guard(coalescing.lock);
+			if (flight.waiting > 0)
+				return true;
+
+			coalescing.close(key, &flight);  // stopped search is not joined
+			return false;
+		}
+
+    private:
+		TCoalescing        &coalescing;
+		const string       &key;
+		TFlight            &flight;
+		TSuggestionHandler &handler;
+		bool                accepts;
+};
+
+template <class TAutocompleteType>
+TCoalescing<TAutocompleteType>::TCoalescing(const TAutocompleteType &ac)
+	: ac(ac), n_searches(0), n_coalesced(0), n_saved_expansions(0)
+{
+}
+
+template <class TAutocompleteType>
+void TCoalescing<TAutocompleteType>::close(const string &key, const TFlight *flight)
+{
+	typename unordered_map<string, TFlight *>::iterator i(flights.find(key));
+	if (i != flights.end() && i->second == flight)  // key can be searched by a newer flight
+		flights.erase(i);
+}
+
+template <class TAutocompleteType>
+void TCoalescing<TAutocompleteType>::autocomplete(const string             &query,
+	                                                    TSuggestionHandler &handler,
+											      const size_t             max_suggestions,
+											      const uint64_t           filter,
+											            TSearchStats       &stats,
+											      const unsigned int       budget)
+{
+	string key;
+	fold_case(string(query, std::min(query.find_first_not_of(' '), query.size())), key);  // search ignores leading spaces and case
+	key.append((const char *)&max_suggestions, sizeof(max_suggestions));
+	key.append((const char *)&filter, sizeof(filter));
+	key.append((const char *)&budget, sizeof(budget));
+
+	TFlight *flight(nullptr);
+	bool     first(false);
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		typename unordered_map<string, TFlight *>::iterator i(flights.find(key));
+		if (i == flights.end())
+		{
+			flight = new TFlight();
+			flights[key] = flight;
+			first = true;
+		}
+		else
+		{
+			flight = i->second;
+			++flight->waiting;
+		}
+	}
+
+	if (first)
+	{
+		TStream stream(*this, key, *flight, handler);
+		std::exception_ptr error;
+		try
+		{
+			ac.autocomplete(query, stream, max_suggestions, filter, stats, budget);
+		}
+		catch (...)  // waiting requests get suggestions found before and the error
+		{
+			error = std::current_exception();
+		}
+
+		++n_searches;
+
+		bool release(false);
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			close(key, flight);
+			flight->stats = stats;
+			flight->error = error;
+			flight->done  = true;
+			flight->found.notify_all();  // under lock - waiting requests release flight only after it is unlocked
+
+			release = flight->waiting == 0;
+		}
+
+		if (release)
+			delete flight;
+
+		if (error)
+			std::rethrow_exception(error);
+		if (stream.error)
+			std::rethrow_exception(stream.error);
+		return;
+	}
+
+	// suggestions are passed on as the search finds them, until handler stops
+	stats = TSearchStats();
+
+	vector<string> suggestions;
+	vector<float>  scores;
+	size_t             taken(0);  // suggestions of flight passed on to handler
+	bool               accepts(true), done(false);
+	std::exception_ptr error;     // of search or handler
+	while (accepts && !done)
+	{
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while (!flight->done && taken == flight->suggestions.size())
+				flight->found.wait(guard);
+
+			suggestions.assign(flight->suggestions.begin() + taken, flight->suggestions.end());
+			scores.assign(flight->scores.begin() + taken, flight->scores.end());
+			taken = flight->suggestions.size();
+
+			done = flight->done;
+			if (done)
+			{
+				stats = flight->stats;
+				error = flight->error;
+			}
+		}
+
+		try
+		{
+			for (size_t i(0); i < suggestions.size() && accepts; ++i)
+				accepts = handler.found(suggestions[i], scores[i]);
+		}
+		catch (...)  // flight is released first
+		{
+			error   = std::current_exception();
+			accepts = false;
+		}
+	}
+
+	stats.coalesced = true;  // stats of search are not known if handler stopped before it was done
+
+	++n_coalesced;
+	n_saved_expansions += stats.expansions;
+
+	bool release(false);
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		release = --flight->waiting == 0 && flight->done;  // stopped request leaves - search can stop without it
+	}
+
+	if (release)
+		delete flight;
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+template class TCoalescing<TAutocomplete>;
+template class TCoalescing<TLoudsAutocomplete>;
+template class TCoalescing<TArtAutocomplete>;
+template class TCoalescing<TPagedAutocomplete>;
+template class TCoalescing<TFederatedAutocomplete>;
+
+
+struct TThreadPool::TJob
+{
+	TJob(const size_t n_tasks, const std::function<void (size_t)> &task)
+		: n_tasks(n_tasks), task(task), next(0), finished(0) {}
+
+	const size_t                          n_tasks;
+	const std::function<void (size_t)>   &task;
+	size_t                                next;      // first unclaimed task
+	size_t                                finished;
+	std::exception_ptr                    error;     // of the first task that failed
+};
+
+TThreadPool::TThreadPool()
+	: stopping(false)
+{
+}
+
+TThreadPool::~TThreadPool()
+{
+	start(0);
+}
+
+void TThreadPool::start(const size_t n_threads)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+		queued.notify_all();
+	}
+
+	for (vector<std::thread>::iterator i(threads.begin()); i != threads.end(); ++i)
+		i->join();
+
+	threads.clear();
+	stopping = false;
+
+	for (size_t k(0); k < n_threads; ++k)
+		threads.push_back(std::thread([this]() { work(); }));
+}
+
+// calling thread claims tasks of its job as pool threads do - the job is done even if all pool threads are busy
+void TThreadPool::run(const size_t n_tasks, const std::function<void (size_t)> &task)
+{
+	TJob job(n_tasks, task);
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (!threads.empty() && n_tasks > 1)
+		{
+			jobs.push_back(&job);
+			queued.notify_all();
+		}
+	}
+
+	for (;;)
+	{
+		size_t k;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (job.next == n_tasks)
+				break;
+
+			k = claim(job);
+		}
+
+		execute(job, k);
+	}
+
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		while (job.finished < n_tasks)
+			done.wait(guard);
+	}
+
+	if (job.error)
+		std::rethrow_exception(job.error);
+}
+
+void TThreadPool::work()
+{
+	for (;;)
+	{
+		TJob   *job;
+		size_t  k;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while (!stopping && jobs.empty())
+				queued.wait(guard);
+
+			if (stopping)
+				return;
+
+			job = jobs.front();
+			k   = claim(*job);
+		}
+
+		execute(*job, k);
+	}
+}
+
+size_t TThreadPool::claim(TJob &job)
+{
+	const size_t k(job.next++);
+	if (job.next == job.n_tasks)  // no more tasks to claim
+	{
+		std::deque<TJob *>::iterator i(std::find(jobs.begin(), jobs.end(), &job));
+		if (i != jobs.end())
+			jobs.erase(i);
+	}
+
+	return k;
+}
+
+void TThreadPool::execute(TJob &job, const size_t k)
+{
+	std::exception_ptr error;
+	try
+	{
+		job.task(k);
+	}
+	catch (...)  // rethrown by run(...)
+	{
+		error = std::current_exception();
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+	if (error && !job.error)
+		job.error = error;
+
+	if (++job.finished == job.n_tasks)
+		done.notify_all();
 }
@@ -25,48 +25,462 @@ using std::vector;
 #include <queue>
 using std::priority_queue;
 
+#include <unordered_map>
+using std::unordered_map;
+
+#include <utility>
+using std::pair;
+
+#include <deque>
+
+#include <functional>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "AutocompleteUtils.h"
+#include "LoudsTrie.h"
+#include "ArtTrie.h"
+#include "PagedTrie.h"
+#include "FederatedTrie.h"
+
+//
+//  receives suggestions as soon as they are found - in descending order of score
+//
+
+class TSuggestionHandler
+{
+    public:
+		virtual ~TSuggestionHandler() {}
+
+		// score is the probability of suggestion given the query; return false to stop the search
+		virtual bool found(const string &suggestion, const float &score) = 0;
+};
+
+//
+//  cost of the last search
+//
 
-class TAutocomplete
+struct TSearchStats
 {
+	TSearchStats()
+		: expansions(0), frontier_peak(0), iteration_cap(false), precomputed(false), degraded(false), coalesced(false) {}
+
+	unsigned int expansions;     // number of expanded candidates
+	unsigned int frontier_peak;  // max number of candidates waiting for expansion
+	bool         iteration_cap;  // search gave up without suggestion after max number of iterations
+	bool         precomputed;    // suggestions were looked up in answer table - no search
+	bool         degraded;       // search was stopped at expansion budget - suggestions can be missing
+	bool         coalesced;      // suggestions were shared by identical concurrent search; cost is of that search (see TCoalescing)
+};
+
+//
+//  threads started once that run tasks of concurrent callers, so that a query split among threads does not start them
+//
+
+class TThreadPool
+{
+    public:
+
+		TThreadPool();
+		~TThreadPool();
+
+		void start(const size_t n_threads);  // running threads are stopped first; not while run(...) is in use
+
+		// runs task(0), ..., task(n_tasks - 1) in pool threads and in the calling thread and returns when all are done;
+		// an exception of a task is rethrown in the calling thread after all tasks are done
+		void run(const size_t n_tasks, const std::function<void (size_t)> &task);
+
     private:
-		TTrie     trie;
-		TKeyboard keyboard;
+
+		struct TJob;  // tasks of one run
+
+		void work();                       // pool thread
+		size_t claim(TJob &job);           // next task of job; lock is held
+		void execute(TJob &job, const size_t k);
+
+		std::mutex               lock;     // guards jobs and their state
+		std::condition_variable  queued;   // job with unclaimed tasks or stop
+		std::condition_variable  done;     // task done
+		std::deque<TJob *>       jobs;     // with unclaimed tasks
+		vector<std::thread>      threads;
+		bool                     stopping;
+
+		TThreadPool(const TThreadPool &);
+		TThreadPool &operator=(const TThreadPool &);
+};
+
+//
+//  best-first search for suggestions over trie representation TIndex (TTrie, TLoudsTrie, TArtTrie, TFederatedTrie)
+//    - search starts at every root of TIndex
+//    - TModel is the typing error model and TLayout the keyboard layout (see TTypingErrors, TKeyboard); both are
+//      policies resolved at compile time, so error probabilities are inlined and constant folded into search
+//
+
+template <class TIndex, class TModel = TTypingErrors, class TLayout = TKeyboard>
+class TBasicAutocomplete
+{
+    protected:
+		TIndex    trie;
+		TLayout   keyboard;
+
+		vector<unsigned int> *node_hits;  // node access counters - only set while tracing queries for relayout(...)
+		TSearchStats          search_stats;
+		size_t                beam_width;  // 0 -> best-first search
+		unsigned int          parallel_threads;     // threads finishing expensive queries; 0, 1 -> single thread
+		size_t                parallel_expansions;  // expansions of query before it is finished in parallel
+		mutable TThreadPool   workers;              // parallel_threads - 1 threads; the searching thread is one of them
+
+		vector<pair<size_t, string> >          typo_prefixes;       // trie nodes at depth typo_prefix_length and their prefixes
+		unordered_map<string, vector<size_t> > typo_index;          // prefix and its one char deletions -> typo_prefixes
+		size_t                                 typo_prefix_length;
+
+		struct TAnswerTable  // suggestions of all short queries (see build_answer_table)
+		{
+			TAnswerTable();
+
+			unsigned char    rank[256];        // query character -> rank in alphabet (1 based); 0 -> not in alphabet
+			size_t           alphabet_size, max_length, max_suggestions, beam_width;
+			vector<uint32_t> queries;          // suggestions of query with key k are [queries[k], queries[k + 1])
+			vector<uint32_t> suggestions;      // offsets of suggestions in text
+			vector<float>    scores;
+			string           text;             // '\0' terminated suggestions
+
+			bool key(const string::const_iterator &begin, const string::const_iterator &end, size_t &key) const;
+		};
+		TAnswerTable answers;
+
+		typedef typename TIndex::TNodeRef   TNodeRef;
+		typedef typename TIndex::TSubTreeIt TSubTreeIt;
+		typedef TBasicAction<TIndex>        TAction;
+		typedef TBasicCandidate<TIndex>     TCandidate;
 
 		typedef priority_queue<TCandidate> TCandidates;
 
+		struct TStep  // error probabilities and normalization factors of transitions for expansion of one candidate
+		{
+			TStep(const TCandidate &candidate, const TLayout &keyboard, const string::const_iterator &query_begin);
+
+			float hit, insertion, begin_insertion_penalty, substitution, begin_substitution_penalty, deletion, transposition;
+			float sum_no_correction, sum_insert, sum_substitute;
+		};
+
+		struct TParallel;  // suggestions and bound shared by threads of one query
+
+		struct TSearch  // state of best-first search - searches of a batch are advanced by one step in turns
+		{
+			TSearch(const string::const_iterator &begin, const string::const_iterator &end, vector<string> &suggestions, const size_t max_suggestions,
+				    TSuggestionHandler *handler, TSearchStats &stats, const uint64_t filter)
+				: begin(begin), end(end), suggestions(&suggestions), max_suggestions(max_suggestions), handler(handler), stats(&stats), filter(filter),
+				  min_suggestion_prob((float).0), iteration(0), budget(0), parallel(nullptr), finished(false) {}
+
+			TCandidates             candidates;
+			string::const_iterator  begin, end;
+			vector<string>         *suggestions;
+			size_t                  max_suggestions;
+			TSuggestionHandler     *handler;
+			TSearchStats           *stats;
+			uint64_t                filter;
+			float                   min_suggestion_prob;  // min probability of acceptable candidate
+			unsigned int            iteration;
+			unsigned int            budget;    // max expansions; 0 -> no limit
+			TParallel              *parallel;  // nullptr -> search is not split among threads
+			bool                    finished;  // no more suggestions can be found (search was not stopped by max_suggestions or handler)
+		};
+
 		// autocomplete routines	
-		void autocomplete(const string::const_iterator &begin, const string::const_iterator &end, vector<string> &suggestions, const size_t max_suggestions);
-		void expand(const TCandidate &candidate, TCandidates &candidates, const string::const_iterator &query_begin, const string::const_iterator &query_end, const float &min_prob);
+		void complete(const string &query, vector<string> &suggestions, const size_t max_suggestions, TSuggestionHandler *handler, const uint64_t filter,
+			          TSearchStats &stats, const unsigned int budget = 0) const;
+		void autocomplete(const string::const_iterator &begin, const string::const_iterator &end, vector<string> &suggestions, const size_t max_suggestions,
+			              TSuggestionHandler *handler, TSearchStats &stats, const uint64_t &filter, const unsigned int budget = 0) const;
+		void start(TCandidates &candidates, const string::const_iterator &begin, const string::const_iterator &end, const uint64_t &filter) const;
+		void search(TCandidates &candidates, const string::const_iterator &begin, const string::const_iterator &end, vector<string> &suggestions, 
+			        const size_t max_suggestions, TSuggestionHandler *handler, TSearchStats &stats, const uint64_t &filter, const unsigned int budget = 0) const;
+		bool step(TSearch &search) const;  // expands the best candidate; false when search is finished
+		void parallel_search(TSearch &search) const;
+		void beam_search(const string::const_iterator &begin, const string::const_iterator &end, vector<string> &suggestions, const size_t max_suggestions,
+			             TSuggestionHandler *handler, TSearchStats &stats, const uint64_t &filter, const unsigned int budget = 0) const;
+		void beam(TCandidates &candidates, const string::const_iterator &begin, const string::const_iterator &end, TSearchStats &stats, const uint64_t &filter) const;
+		void expand(const TCandidate &candidate, TCandidates &candidates, const string::const_iterator &query_begin, const string::const_iterator &query_end, const float &min_prob, const uint64_t &filter) const;
 		void split(const TCandidate &candidate, const string::const_iterator &query_begin, const string::const_iterator &query_end,
-			       float &best_left, TCandidate &best, float &best_right, TAction &action);
+			       float &best_left, TCandidate &best, float &best_right, TAction &action, const uint64_t &filter) const;
         void add_candidates(TCandidates &candidates, const TCandidate  &candidate,  const float &min_prob, 
-					        const float &best_left, const TCandidate  &best, const float &best_right, TAction &best_action);
+					        const float &best_left, const TCandidate  &best, const float &best_right, TAction &best_action) const;
+		bool expand_action(const TCandidate &candidate, TAction &action, TStep &step, const string::const_iterator &query_begin, 
+			               const string::const_iterator &query_end, float &best_left, TCandidate &best, float &best_right, const uint64_t &filter) const;
 		// generation of successor candidates
-        void expand_matched_query(const TCandidate &candidate, TCandidates &candidates);
+        void expand_matched_query(const TCandidate &candidate, TCandidates &candidates, const uint64_t &filter) const;
 		bool expand_no_correction(const float &hit_prob, float &sum_transition_prob, const TCandidate &candidate, const TAction &action, 
-			                      const string::const_iterator &query_end, float &best_left, TCandidate &best, float &best_right);
+			                      const string::const_iterator &query_end, float &best_left, TCandidate &best, float &best_right, const uint64_t &filter) const;
 		bool expand_substitute_char(const bool &insert_char, const float &substitution_prob, float &sum_transition_prob, const TCandidate &candidate, TAction &action, 
 			                        const string::const_iterator  &query_begin, const string::const_iterator  &query_end, const float &begin_penalty,
-									float &best_left, TCandidate &best, float &best_right);
+									float &best_left, TCandidate &best, float &best_right, const uint64_t &filter) const;
         bool expand_delete_char(const float &deletion_prob, const TCandidate  &candidate, const string::const_iterator &query_end,
-			                    float &best_left, TCandidate &best, float &best_right);    	
+			                    float &best_left, TCandidate &best, float &best_right) const;    	
         bool expand_transpose_char(const float &transposition_prob, const TCandidate &candidate, const string::const_iterator &query_end,
-			                       float &best_left, TCandidate &best, float &best_right);
+			                       float &best_left, TCandidate &best, float &best_right, const uint64_t &filter) const;
 
 		// utility routines
-        bool transition_prob(const TCandidate &candidate, TTrie::Node &subtree, const string::const_iterator  &query_begin, 
-                              const float &begin_penalty, float &transition_prob, bool &exact_match);
+        bool transition_prob(const TCandidate &candidate, const char &subtree, const string::const_iterator  &query_begin, 
+                              const float &begin_penalty, float &transition_prob, bool &exact_match) const;
+
+		bool transpose(const TCandidate &candidate, const string::const_iterator &query_end, string &transposition, TNodeRef &transposition_end, const uint64_t &filter) const;
+
+		void trace(const TCandidate &candidate) const;
+
+		void seed(const string::const_iterator &query_begin, const string::const_iterator &query_end, vector<TCandidate> &seeds, const uint64_t &filter) const;
+		void seed(const string &key, const size_t &consumed, const float &query_probability, const string::const_iterator &query_begin,
+			      vector<TCandidate> &seeds, const uint64_t &filter) const;
+
+		void trie_changed();  // trie was replaced or renumbered - indexes of its nodes are rebuilt, answer table is dropped
+
+		// filter - attributes accepted by current query
+		bool admits(const size_t sub_tree, const uint64_t &filter) const { return filter == TTrie::any_attribute || (trie.attributes(sub_tree) & filter) != 0; };
+		float bound(const size_t sub_tree, const uint64_t &filter) const { return filter == TTrie::any_attribute ? trie.prob(sub_tree) : trie.prob(sub_tree, filter); };
+		bool admits_root(const uint64_t &filter) const;
 
-		bool transpose(const TCandidate &candidate, const string::const_iterator &query_end, string &transposition, TTrie::Node **transposition_end);
+		bool precomputed(const string::const_iterator &begin, const string::const_iterator &end, vector<string> &suggestions,
+			             const size_t max_suggestions, TSuggestionHandler *handler, const uint64_t &filter, TSearchStats &stats) const;
 
     public:
+
+		TBasicAutocomplete();
 		
 		void autocomplete(const string         &query,  // no need to normalize query
 			                    vector<string> &suggestions,
-						  const size_t         max_suggestions = 5);
+						  const size_t         max_suggestions = 5,
+						  const uint64_t       filter = TTrie::any_attribute);  // only words with any of these attributes (see TTrie::attribute) are suggested
+
+		// streaming variant - handler receives each suggestion as soon as it is found and can stop the search
+		void autocomplete(const string             &query,
+			                    TSuggestionHandler &handler,
+						  const size_t             max_suggestions = 5,
+						  const uint64_t           filter = TTrie::any_attribute);
+
+		// reentrant streaming variant - several threads can search at once; cost of the search is returned in stats;
+		// search stops after budget expansions (stats.degraded), e.g. to shed load (see TLoadControl); 0 -> no budget
+		void autocomplete(const string             &query,
+			                    TSuggestionHandler &handler,
+						  const size_t             max_suggestions,
+						  const uint64_t           filter,
+						        TSearchStats       &stats,
+						  const unsigned int       budget = 0) const;
+
+		// batch variant - up to width searches are interleaved: they are advanced by one expansion in turns and each
+		// prefetches nodes of its next expansion, so that cache misses of one search overlap with work of the others;
+		// suggestions are the same as of separate queries (beam search is not interleaved)
+		void autocomplete(const vector<string>         &queries,
+			                    vector<vector<string> > &suggestions,
+			                    vector<TSearchStats>    &stats,
+						  const size_t                  max_suggestions = 5,
+						  const uint64_t                filter = TTrie::any_attribute,
+						  const size_t                  width = 8) const;
+
+		// stopped search of a query - remaining candidates and suggestions found so far; it refers to the query it holds,
+		// so it can not be copied
+		class TContinuation
+		{
+		    public:
+				TContinuation()
+					: offset(0), filter(TTrie::any_attribute), min_suggestion_prob((float).0), iteration(0), done(true) {}
+
+				bool   finished() const    { return done; };           // no more suggestions
+				size_t suggestions() const { return found.size(); };   // found so far
+
+		    private:
+				friend class TBasicAutocomplete;
+
+				TContinuation(const TContinuation &);
+				TContinuation &operator=(const TContinuation &);
+
+				string         query;   // candidates point into it
+				size_t         offset;  // of query without leading spaces
+				vector<string> found;
+				TCandidates    candidates;
+				uint64_t       filter;
+				float          min_suggestion_prob;
+				unsigned int   iteration;
+				bool           done;
+		};
+
+		// paginated variant - the first max_suggestions suggestions; the search is kept in continuation and resume(...)
+		// yields the next ones at the cost of their expansions only, in the same order as one search for more
+		// suggestions; answer table and parallel search are not used
+		void autocomplete(const string             &query,
+			                    TSuggestionHandler &handler,
+						  const size_t             max_suggestions,
+						  const uint64_t           filter,
+						        TSearchStats       &stats,
+						        TContinuation      &continuation) const;
+
+		// next max_suggestions suggestions of continuation; stats holds the cost of this call
+		void resume(TContinuation &continuation, TSuggestionHandler &handler, const size_t max_suggestions, TSearchStats &stats) const;
+
+		const TIndex &index() const { return trie; };
+
+		const TSearchStats &stats() const { return search_stats; };  // of the last query
+
+		// beam search keeps only width best candidates per query position - bounded latency at the cost of
+		// occasionally missing a suggestion found by (default) best-first search; 0 -> best-first search
+		void set_beam_width(const size_t width) { beam_width = width; };
+
+		// queries that expanded min_expansions candidates and found a suggestion are finished in n_threads: frontier is
+		// dealt among threads that share found suggestions and the probability bound for pruning; suggestions are those of
+		// single thread search, only suggestions of equal score can be ordered differently; 0 or 1 (default) -> single thread
+		// threads are started once and kept - not to be called while searching
+		void set_parallel(const unsigned int n_threads, const size_t min_expansions = 2000);
 
-		void load(const string &file_name);
+		// index deletion variants of first prefix_length characters of dictionary words (in lower case, as keyboard
+		// does not tell cases apart); if the first characters of query are not a prefix of any word, search is started
+		// also at nodes within one edit of them; index is rebuilt when trie is loaded, minimized or relaid out
+		void build_typo_index(const size_t prefix_length = 4);
+
+		// precompute suggestions of all queries of up to max_length characters from dictionary alphabet in n_threads
+		// (0 -> one per core); such queries are answered by a lookup if they ask for at most max_suggestions without
+		// filter and with the beam width set at build time - suggestions are the same as found by search;
+		// table is dropped when trie is loaded, minimized or relaid out
+		void build_answer_table(const size_t max_length = 2, const size_t max_suggestions = 5, const unsigned int n_threads = 0);
+		size_t answer_table_memory() const;  // bytes
+
+    private:
+
+		void advance(TContinuation &continuation, TSuggestionHandler &handler, const size_t max_suggestions, TSearchStats &stats) const;
+};
+
+
+class TAutocomplete : public TBasicAutocomplete<TTrie>
+{
+    public:
+
+		// load plain or gzip compressed dictionary; returns number of (uncompressed) bytes read
+		size_t load(const string &file_name, const TTrie::Format &format = TTrie::Format());
+
+		// share common suffixes of dictionary words (see TTrie::minimize); suggestions are not affected
+		void minimize();
+
+		// renumber trie nodes so that nodes accessed by the queries are packed together; suggestions are not affected
+		void relayout(const vector<string> &queries);
+		void relayout(const string &query_log_file_name);  // one query per line
 };
 
 
+//
+//  TAutocomplete with the error model and keyboard layout evaluated at run time (see TReferenceErrors,
+//  TReferenceKeyboard) - reference for checking that compile time policies find the same suggestions and scores
+//
+
+class TReferenceAutocomplete : public TBasicAutocomplete<TTrie, TReferenceErrors, TReferenceKeyboard>
+{
+    public:
+
+		size_t load(const string &file_name, const TTrie::Format &format = TTrie::Format());
+};
+
+
+//
+//  autocomplete over succinct trie (see TLoudsTrie) - fraction of TAutocomplete memory at the cost of slower navigation;
+//  suggestions can differ from TAutocomplete only among nearly equally probable words due to quantized probabilities
+//
+
+class TLoudsAutocomplete : public TBasicAutocomplete<TLoudsTrie>
+{
+    public:
+
+		size_t load(const string &file_name, const TTrie::Format &format = TTrie::Format());
+};
+
+
+//
+//  autocomplete over trie with adaptive node kinds (see TArtTrie) - several times less memory than TAutocomplete
+//  and subtrees are adjacent in memory; suggestions are the same as of TAutocomplete
+//
+
+class TArtAutocomplete : public TBasicAutocomplete<TArtTrie>
+{
+    public:
+
+		size_t load(const string &file_name, const TTrie::Format &format = TTrie::Format());
+};
+
+
+//
+//  autocomplete over trie in index file (see TPagedTrie) - dictionaries larger than memory are paged in on demand;
+//  suggestions are the same as of TAutocomplete
+//
+
+class TPagedAutocomplete : public TBasicAutocomplete<TPagedTrie>
+{
+    public:
+
+		// pack dictionary into index file; returns number of (uncompressed) bytes read
+		static size_t build(const string &file_name, const string &index_file_name, const TTrie::Format &format = TTrie::Format(),
+			                const size_t page_size = 4096);
+
+		void   open(const string &index_file_name);
+		size_t pin(const size_t bytes);  // see TPagedTrie::pin
+};
+
+
+//
+//  autocomplete over several dictionaries (see TFederatedTrie) - one search ranks words of all dictionaries,
+//  instead of merging suggestions of separate searches
+//
+
+class TFederatedAutocomplete : public TBasicAutocomplete<TFederatedTrie>
+{
+    public:
+
+		// add dictionary with prior probability (relative weight of its words); name is the filter attribute
+		// of dictionary words, e.g. autocomplete(query, suggestions, 5, ac.index().attribute("streets"))
+		size_t load(const string &name, const string &file_name, const float prior = 1., const TTrie::Format &format = TTrie::Format());
+};
+
+
+//
+//  in-flight coalescing of identical queries - the first request of a query searches, requests of the same query
+//  (without leading spaces, in any case), max suggestions, filter and budget that arrive during its search wait for it
+//  and get its suggestions as it finds them; nothing is kept after the search ends, so it works with or without a result
+//  cache
+//    - a request whose handler stops taking suggestions leaves the search; the search stops once no request takes more
+//    - TAutocompleteType is any of TAutocomplete, TLoudsAutocomplete, TArtAutocomplete, TPagedAutocomplete,
+//      TFederatedAutocomplete; it is searched by its reentrant autocomplete and must not change while in use
+//
+
+template <class TAutocompleteType>
+class TCoalescing
+{
+    public:
+
+		TCoalescing(const TAutocompleteType &ac);
+
+		// as reentrant TBasicAutocomplete::autocomplete; stats.coalesced is set if suggestions were shared (stats of the
+		// search are left empty if handler stopped before the search ended); an error of the search is rethrown in every
+		// request after the suggestions found before it
+		void autocomplete(const string             &query,
+			                    TSuggestionHandler &handler,
+						  const size_t             max_suggestions,
+						  const uint64_t           filter,
+						        TSearchStats       &stats,
+						  const unsigned int       budget = 0);
+
+		uint64_t searches() const         { return n_searches.load(); };        // queries searched
+		uint64_t coalesced() const        { return n_coalesced.load(); };       // queries that waited for identical search
+		uint64_t saved_expansions() const { return n_saved_expansions.load(); };  // expansions of searches not repeated
+
+    private:
+
+		struct TFlight;  // search in progress
+		class  TStream;  // handler of search passing suggestions on to requests
+
+		void close(const string &key, const TFlight *flight);  // later requests of key do not join flight; lock is held
+
+		const TAutocompleteType          &ac;
+		std::mutex                        lock;  // guards flights and their state
+		unordered_map<string, TFlight *>  flights;
+		std::atomic<uint64_t>             n_searches, n_coalesced, n_saved_expansions;
+
+		TCoalescing(const TCoalescing &);
+		TCoalescing &operator=(const TCoalescing &);
+};
@@ -0,0 +1,263 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "AutocompleteC.h"
+#include "Autocomplete.h"
+
+#include <cstring>
+#include <exception>
+#include <new>
+
+struct ac_index
+{
+	ac_index()
+		: coalescing(ac), coalesce(false) {}
+
+	TAutocomplete                      ac;
+	mutable TCoalescing<TAutocomplete> coalescing;  // used by ac_complete if coalesce is set
+	bool                               coalesce;
+};
+
+struct ac_search
+{
+	const ac_index *index;
+	TSearchStats    stats;
+	unsigned int    budget;  // 0 -> full search
+};
+
+namespace
+{
+	void set_error(char *error, const size_t error_size, const char *message)
+	{
+		if (!error || error_size == 0)
+			return;
+
+		strncpy(error, message, error_size - 1);
+		error[error_size - 1] = '\0';
+	}
+
+	//
+	// appends suggestions to caller buffer; stops the search when buffer or suggestions are full
+	//
+	class TBufferHandler : public TSuggestionHandler
+	{
+	    public:
+			TBufferHandler(char *buffer, const size_t buffer_size, ac_suggestion *suggestions, const size_t max_suggestions)
+				: buffer(buffer), buffer_size(buffer_size), used(0), suggestions(suggestions), max_suggestions(max_suggestions), n(0), truncated(false) {}
+
+			virtual bool found(const string &suggestion, const float &score)
+			{
+				if (n == max_suggestions)
+					return false;
+
+				if (used + suggestion.size() + 1 > buffer_size)
+				{
+					truncated = true;
+					return false;
+				}
+
+				char *text(buffer + used);
+				memcpy(text, suggestion.c_str(), suggestion.size() + 1);
+				used += suggestion.size() + 1;
+
+				suggestions[n].text   = text;
+				suggestions[n].length = suggestion.size();
+				suggestions[n].score  = score;
+
+				return ++n < max_suggestions;
+			}
+
+			char          *buffer;
+			size_t         buffer_size, used;
+			ac_suggestion *suggestions;
+			size_t         max_suggestions, n;
+			bool           truncated;
+	};
+}
+
+ac_format ac_format_default(void)
+{
+	const TTrie::Format defaults;
+
+	ac_format format;
+	format.delimiter        = defaults.delimiter;
+	format.weight_column    = defaults.weight_column;
+	format.word_column      = defaults.word_column;
+	format.attribute_column = defaults.attribute_column;
+	format.default_weight   = defaults.default_weight;
+	format.header           = defaults.header;
+	format.fold_case        = defaults.fold_case;
+
+	return format;
+}
+
+ac_index *ac_open(const char *file_name, const ac_format *format, char *error, size_t error_size)
+{
+	set_error(error, error_size, "");
+	if (!file_name)
+	{
+		set_error(error, error_size, "ac_open - no file name");
+		return nullptr;
+	}
+
+	ac_index *index(nullptr);
+	try
+	{
+		TTrie::Format f;
+		if (format)
+		{
+			f.delimiter        = format->delimiter;
+			f.weight_column    = format->weight_column;
+			f.word_column      = format->word_column;
+			f.attribute_column = format->attribute_column;
+			f.default_weight   = format->default_weight;
+			f.header           = format->header != 0;
+			f.fold_case        = format->fold_case != 0;
+		}
+
+		index = new ac_index;
+		index->ac.load(file_name, f);
+
+		return index;
+	}
+	catch (const std::exception &e)
+	{
+		set_error(error, error_size, e.what());
+	}
+	catch (...)
+	{
+		set_error(error, error_size, "ac_open - unknown error");
+	}
+
+	delete index;
+	return nullptr;
+}
+
+void ac_close(ac_index *index)
+{
+	delete index;
+}
+
+int ac_build_answer_table(ac_index *index, size_t max_length, size_t max_suggestions)
+{
+	try
+	{
+		index->ac.build_answer_table(max_length, max_suggestions);
+		return AC_OK;
+	}
+	catch (...)
+	{
+		return AC_ERROR;
+	}
+}
+
+void ac_set_coalescing(ac_index *index, int enabled)
+{
+	index->coalesce = enabled != 0;
+}
+
+size_t ac_memory(const ac_index *index)
+{
+	return index->ac.index().memory() + index->ac.answer_table_memory();
+}
+
+uint64_t ac_attribute(const ac_index *index, const char *value)
+{
+	try
+	{
+		return index->ac.index().attribute(value);
+	}
+	catch (...)
+	{
+		return 0;
+	}
+}
+
+ac_search *ac_search_new(const ac_index *index)
+{
+	if (!index)
+		return nullptr;
+
+	ac_search *search(new (std::nothrow) ac_search);
+	if (search)
+	{
+		search->index  = index;
+		search->budget = 0;
+	}
+
+	return search;
+}
+
+void ac_search_free(ac_search *search)
+{
+	delete search;
+}
+
+int ac_complete(ac_search *search, const char *query, size_t max_suggestions, uint64_t filter,
+	            char *buffer, size_t buffer_size, ac_suggestion *suggestions, size_t *n_suggestions)
+{
+	return ac_complete_batch(search, &query, 1, max_suggestions, filter, buffer, buffer_size, suggestions, n_suggestions);
+}
+
+int ac_complete_batch(ac_search *search, const char *const *queries, size_t n_queries, size_t max_suggestions, uint64_t filter,
+	                  char *buffer, size_t buffer_size, ac_suggestion *suggestions, size_t *n_suggestions)
+{
+	if (!search || !queries || !n_suggestions || (max_suggestions > 0 && (!suggestions || (buffer_size > 0 && !buffer))))
+		return AC_ERROR;
+
+	bool truncated(false);
+	try
+	{
+		for (size_t q(0); q < n_queries; ++q)
+		{
+			TBufferHandler handler(buffer, buffer_size, suggestions + q * max_suggestions, max_suggestions);
+			if (queries[q] && max_suggestions > 0 && !truncated)
+			{
+				if (search->index->coalesce)
+					search->index->coalescing.autocomplete(queries[q], handler, max_suggestions, filter, search->stats, search->budget);
+				else
+					search->index->ac.autocomplete(queries[q], handler, max_suggestions, filter, search->stats, search->budget);
+			}
+
+			n_suggestions[q] = handler.n;
+			truncated |= handler.truncated;
+
+			buffer      += handler.used;
+			buffer_size -= handler.used;
+		}
+	}
+	catch (...)
+	{
+		return AC_ERROR;
+	}
+
+	return truncated ? AC_BUFFER_TOO_SMALL : AC_OK;
+}
+
+void ac_last_stats(const ac_search *search, ac_stats *stats)
+{
+	stats->expansions    = search->stats.expansions;
+	stats->frontier_peak = search->stats.frontier_peak;
+	stats->iteration_cap = search->stats.iteration_cap;
+	stats->precomputed   = search->stats.precomputed;
+	stats->degraded      = search->stats.degraded;
+	stats->coalesced     = search->stats.coalesced;
+}
+
+void ac_set_budget(ac_search *search, unsigned int budget)
+{
+	search->budget = budget;
+}
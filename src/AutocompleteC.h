@@ -0,0 +1,119 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+//  C interface for FFI users (Python ctypes, PHP FFI, cgo, ...)
+//    - ac_index is a loaded dictionary; after loading (and build_answer_table) it is read only and shared by all threads
+//    - ac_search holds the state of one searching thread; every thread needs its own handle
+//    - suggestions are written into caller owned buffers - there is no global state and no pointers into library memory
+//    - C++ exceptions do not cross the interface; failures are reported with return codes
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ac_index  ac_index;
+typedef struct ac_search ac_search;
+
+#define AC_OK                0
+#define AC_BUFFER_TOO_SMALL  1   // suggestions that did not fit into buffer were dropped; the rest are valid
+#define AC_ERROR            -1
+
+#define AC_NO_COLUMN      0xffffffffu
+#define AC_ANY_ATTRIBUTE  (~(uint64_t)0)
+
+typedef struct ac_format  // dictionary file layout (see TTrie::Format)
+{
+	char         delimiter;
+	unsigned int weight_column;
+	unsigned int word_column;
+	unsigned int attribute_column;  // AC_NO_COLUMN -> words have no attributes
+	float        default_weight;    // weight of entries with empty weight field; 0 -> empty weight is an error
+	int          header;            // skip the first line
+	int          fold_case;         // store words in lower case, display the most weighted spelling
+} ac_format;
+
+typedef struct ac_suggestion
+{
+	const char *text;    // '\0' terminated, points into caller buffer
+	size_t      length;
+	float       score;   // probability of suggestion given the query
+} ac_suggestion;
+
+typedef struct ac_stats  // cost of the last search of a handle (see TSearchStats)
+{
+	unsigned int expansions;
+	unsigned int frontier_peak;
+	int          iteration_cap;
+	int          precomputed;
+	int          degraded;       // search was stopped at budget (see ac_set_budget)
+	int          coalesced;      // suggestions were shared by identical concurrent search (see ac_set_coalescing)
+} ac_stats;
+
+ac_format ac_format_default(void);  // "weight word" per line
+
+// load plain or gzip compressed dictionary; format NULL -> default; returns NULL on failure with message in error (may be NULL)
+ac_index *ac_open(const char *file_name, const ac_format *format, char *error, size_t error_size);
+void      ac_close(ac_index *index);
+
+// precompute suggestions of short queries; must be called before the index is shared by searching threads
+int       ac_build_answer_table(ac_index *index, size_t max_length, size_t max_suggestions);
+
+// identical queries searched by several threads at the same time share one search (see TCoalescing); off by default
+void      ac_set_coalescing(ac_index *index, int enabled);
+
+size_t    ac_memory(const ac_index *index);                        // bytes used by index and answer table
+uint64_t  ac_attribute(const ac_index *index, const char *value);  // filter bit of attribute value; 0 if it does not occur
+
+ac_search *ac_search_new(const ac_index *index);  // NULL on failure
+void       ac_search_free(ac_search *search);
+
+// suggestions in descending order of score; texts are stored in buffer one after another
+int ac_complete(ac_search     *search,
+	            const char    *query,
+	            size_t         max_suggestions,
+	            uint64_t       filter,          // AC_ANY_ATTRIBUTE -> all words
+	            char          *buffer,
+	            size_t         buffer_size,
+	            ac_suggestion *suggestions,     // max_suggestions entries
+	            size_t        *n_suggestions);
+
+// suggestions of queries[i] are at suggestions[i * max_suggestions], their number in n_suggestions[i]
+//   - queries share buffer; once it is full, the remaining queries get no suggestions
+int ac_complete_batch(ac_search         *search,
+	                  const char *const *queries,
+	                  size_t             n_queries,
+	                  size_t             max_suggestions,
+	                  uint64_t           filter,
+	                  char              *buffer,
+	                  size_t             buffer_size,
+	                  ac_suggestion     *suggestions,    // n_queries * max_suggestions entries
+	                  size_t            *n_suggestions); // n_queries entries
+
+void ac_last_stats(const ac_search *search, ac_stats *stats);
+
+// searches of handle stop after budget expansions, e.g. to shed load (see TLoadControl); 0 -> full search (default)
+void ac_set_budget(ac_search *search, unsigned int budget);
+
+#ifdef __cplusplus
+}
+#endif
@@ -15,6 +15,7 @@ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #include "AutocompleteUtils.h"
+#include "ArtTrie.h"
 
 #include <stdexcept>
 using std::runtime_error;
@@ -23,17 +24,26 @@ using std::runtime_error;
 using std::min;
 using std::max;
 
-#include <fstream>
-using std::ifstream;
-
 #include <sstream>
 using std::stringstream;
 
+#include <cstring>
+using std::memchr;
+using std::memmove;
+
+#include <unordered_set>
+using std::unordered_set;
+
+#include <unordered_map>
+using std::unordered_map;
+
+#include <zlib.h>
+
 /*******************
 *   TTrie      * 
 ********************/
 TTrie::TTrie()
-	: sum_weight(.0)
+	: sum_weight(.0), ascending(true)
 {
 	nodes.push_back(Node(' ', .0));
 }
@@ -45,7 +55,160 @@ string error(const string &message, const size_t &line)
 	return s.str();
 }
 
-void TTrie::load(const string file_name)
+// lower case copy of word (ASCII letters); false if word has no upper case letters
+bool fold_case(const string &word, string &folded)
+{
+	folded = word;
+
+	bool folds(false);
+	for (string::iterator i(folded.begin()); i != folded.end(); ++i)
+		if (*i >= 'A' && *i <= 'Z')
+		{
+			*i += 'a' - 'A';
+			folds = true;
+		}
+
+	return folds;
+}
+
+size_t TDisplayForms::memory() const  // approximate - hash table nodes and characters of both strings
+{
+	size_t bytes(forms.bucket_count() * sizeof(void *) + forms.size() * (sizeof(std::pair<const string, string>) + sizeof(void *)));
+	for (TIt i(forms.begin()); i != forms.end(); ++i)
+		bytes += i->first.size() + i->second.size() + 2;
+
+	return bytes;
+}
+
+//
+// reads (optionally gzip compressed) file in large blocks and splits it into lines
+//
+class TLineReader
+{
+	public:
+
+		TLineReader(const string &file_name)
+			: buffer(1 << 20), begin(0), end(0), eof(false), bytes(0)
+		{
+			f = gzopen(file_name.c_str(), "rb");
+			if (f == nullptr)
+				throw runtime_error("TTrie::load - cannot open file " + file_name);
+
+			gzbuffer(f, 1 << 17);
+		}
+
+		~TLineReader()
+		{
+			gzclose(f);
+		}
+
+		// line excludes line delimiter
+		bool next(const char *&line, const char *&line_end)
+		{
+			for (;;)
+			{
+				const char *nl(static_cast<const char *>(memchr(&buffer[begin], '\n', end - begin)));
+				if (nl != nullptr)
+				{
+					line     = &buffer[begin];
+					line_end = nl;
+					begin    = nl - &buffer[0] + 1;
+					return true;
+				}
+
+				if (eof)
+				{
+					if (begin == end)
+						return false;
+
+					line     = &buffer[begin];  // last line without line delimiter
+					line_end = &buffer[end];
+					begin    = end;
+					return true;
+				}
+
+				fill();
+			}
+		}
+
+		size_t size() const { return bytes; }
+
+	private:
+
+		gzFile       f;
+		vector<char> buffer;
+		size_t       begin;   // unread data is in [begin, end)
+		size_t       end;
+		bool         eof;
+		size_t       bytes;   // number of bytes read
+
+		void fill()
+		{
+			// move partial line to the beginning of the buffer
+			memmove(&buffer[0], &buffer[begin], end - begin);
+			end  -= begin;
+			begin = 0;
+
+			if (end == buffer.size())  // line longer than buffer
+				buffer.resize(2 * buffer.size());
+
+			int n(gzread(f, &buffer[end], (unsigned int)(buffer.size() - end)));
+			if (n < 0)
+			{
+				int code;
+				throw runtime_error(string("TTrie::load - cannot read file: ") + gzerror(f, &code));
+			}
+
+			end   += n;
+			bytes += n;
+			eof    = n == 0;
+		}
+};
+
+//
+// locale independent parsing of weight: digits[.digits][(e|E)[+|-]digits]
+//
+bool parse_weight(const char *begin, const char *end, float &weight)
+{
+	double value(.0);
+	const char *p(begin);
+
+	for (; p != end && *p >= '0' && *p <= '9'; ++p)
+		value = 10. * value + (*p - '0');
+
+	if (p != end && *p == '.')
+	{
+		double scale(.1);
+		for (++p; p != end && *p >= '0' && *p <= '9'; ++p, scale *= .1)
+			value += scale * (*p - '0');
+	}
+
+	if (p == begin || (p == begin + 1 && *begin == '.'))  // no digits
+		return false;
+
+	if (p != end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		bool negative(p != end && *p == '-');
+		if (p != end && (*p == '-' || *p == '+'))
+			++p;
+
+		if (p == end)
+			return false;
+
+		int exponent(0);
+		for (; p != end && *p >= '0' && *p <= '9'; ++p)
+			exponent = std::min(10 * exponent + (*p - '0'), 400);  // out of double range either way
+
+		for (; exponent > 0; --exponent)
+			value = negative ? value / 10. : value * 10.;
+	}
+
+	weight = (float)value;
+	return p == end;
+}
+
+size_t TTrie::load(const string file_name, const Format &format)
 {
 	// init Trie
 	if (sum_weight > .0)
@@ -55,76 +218,277 @@ void TTrie::load(const string file_name)
 		sum_weight = .0;
 	}
 
-	ifstream f(file_name.c_str());
-	if (!f)
-		throw runtime_error("TTrie::load - cannot open file " + file_name);
+	masks.clear();
+	attribute_names.clear();
+	forms.clear();
+	last_word.clear();  // path of the previous word may be left by a failed load
+	last_path.clear();
+	ascending = true;
+
+	TLineReader f(file_name);
+
+	const bool has_attributes(format.attribute_column != Format::no_column);
+	bool word_to_end(format.word_column > format.weight_column &&  // last field may contain delimiters
+		             (!has_attributes || format.word_column > format.attribute_column));
+
+	const char *line, *line_end;
+	string      word;
+	size_t      line_number(0);
+
+	unordered_map<string, uint64_t> attribute_bits;
+	string                          value;
 
-	float  freq;
-	string word;
-    size_t line(0);
+	// words are added in ascending order; then new subtrees need no search among existing ones (see add)
+	struct TEntry
+	{
+		string   word;
+		float    weight;
+		uint64_t attributes;
+
+		bool operator<(const TEntry &entry) const { return word < entry.word; }
+	};
+	vector<TEntry> entries;
+	bool           sorted(true);
+
+	typedef vector<std::pair<string, float> > TSpellings;  // upper case spellings of folded word with their weights
+	unordered_map<string, TSpellings> spellings;
+	string                            folded;
+
+	if (format.header && f.next(line, line_end))
+	{
+		++line_number;
+
+		// word extends to the end of line only if it is the last column of header
+		if (line != line_end && *(line_end - 1) == '\r')
+			--line_end;
+		word_to_end = word_to_end && (size_t)std::count(line, line_end, format.delimiter) == format.word_column;
+	}
 
-	while (f >> freq)
+	while (f.next(line, line_end))
 	{
-	    if (!(f.ignore() && getline(f, word, '\n')))
-			throw runtime_error(error("TTrie::load cannot read word", line));
+		++line_number;
+
+		if (line != line_end && *(line_end - 1) == '\r')  // for unix
+			--line_end;
 
-        if (word[word.size() - 1] == '\r')  // for unix
-			word.resize(word.size() - 1);
+		if (line == line_end)
+			continue;
 
-		add(word, freq);	
-		++line;
+		// find weight, word and attribute fields
+		const char *weight_begin(nullptr), *weight_end(nullptr), *word_begin(nullptr), *word_end(nullptr);
+		const char *attribute_begin(nullptr), *attribute_end(nullptr);
+		const char *field(line);
+		for (unsigned int column(0); ; ++column)
+		{
+			const char *field_end(static_cast<const char *>(memchr(field, format.delimiter, line_end - field)));
+			if (field_end == nullptr)
+				field_end = line_end;
+
+			if (column == format.weight_column)
+			{
+				weight_begin = field;
+				weight_end   = field_end;
+			}
+
+			if (column == format.word_column)
+			{
+				word_begin = field;
+				word_end   = word_to_end ? line_end : field_end;
+			}
+
+			if (column == format.attribute_column)
+			{
+				attribute_begin = field;
+				attribute_end   = field_end;
+			}
+
+			if (field_end == line_end || 
+				(weight_begin != nullptr && word_begin != nullptr && (!has_attributes || attribute_begin != nullptr)))
+				break;
+
+			field = field_end + 1;
+		}
+
+		float weight(format.default_weight);
+		if (weight_begin == nullptr || 
+			(weight_begin == weight_end ? weight <= .0 : ! parse_weight(weight_begin, weight_end, weight)))
+			throw runtime_error(error("TTrie::load cannot read weight", line_number));
+
+		if (word_begin == nullptr)
+			throw runtime_error(error("TTrie::load cannot read word", line_number));
+
+		if (has_attributes && attribute_begin == nullptr)
+			throw runtime_error(error("TTrie::load cannot read attributes", line_number));
+
+		// map attribute values to bits in order of appearance
+		uint64_t attributes(0);
+		for (const char *value_begin(attribute_begin); value_begin != attribute_end; )
+		{
+			const char *value_end(static_cast<const char *>(memchr(value_begin, '|', attribute_end - value_begin)));
+			if (value_end == nullptr)
+				value_end = attribute_end;
+
+			if (value_begin != value_end)
+			{
+				value.assign(value_begin, value_end);
+				unordered_map<string, uint64_t>::const_iterator bit(attribute_bits.find(value));
+				if (bit == attribute_bits.end())
+				{
+					if (attribute_names.size() == 64)
+						throw runtime_error(error("TTrie::load more than 64 distinct attribute values", line_number));
+
+					bit = attribute_bits.insert(std::make_pair(value, (uint64_t)1 << attribute_names.size())).first;
+					attribute_names.push_back(value);
+				}
+
+				attributes |= bit->second;
+			}
+
+			value_begin = value_end == attribute_end ? value_end : value_end + 1;
+		}
+
+		word.assign(word_begin, word_end);
+		if (format.fold_case && fold_case(word, folded))
+		{
+			TSpellings &word_spellings(spellings[folded]);
+
+			size_t k(0);
+			while (k < word_spellings.size() && word_spellings[k].first != word)
+				++k;
+
+			if (k == word_spellings.size())
+				word_spellings.push_back(std::make_pair(word, (float).0));
+			word_spellings[k].second += weight;
+
+			word.swap(folded);
+		}
+
+		sorted = sorted && (entries.empty() || !(word < entries.back().word));
+		entries.push_back(TEntry());
+		entries.back().word.swap(word);
+		entries.back().weight     = weight;
+		entries.back().attributes = attributes;
 	}
-	  
-	if (!f.eof())
-		throw runtime_error(error("TTrie::load cannot read weight", line));
+
+	if (!sorted)
+		std::stable_sort(entries.begin(), entries.end());  // stable - duplicates keep order of weights summed
+
+	if (!attribute_names.empty())  // attribute masks are stored only for dictionaries with attributes
+		masks.assign(nodes.size(), 0);
+
+	for (vector<TEntry>::const_iterator i(entries.begin()); i != entries.end(); ++i)
+		add(i->word, i->weight, i->attributes);
+	vector<TEntry>().swap(entries);
+
+	last_word.clear();
+	last_path.clear();
 
 	if (sum_weight == .0)
 		throw runtime_error("TTrie::load " + file_name + " is empty");
 
+	// folded word is displayed in its most weighted spelling; lower case spelling has the rest of word weight
+	for (unordered_map<string, TSpellings>::const_iterator i(spellings.begin()); i != spellings.end(); ++i)
+	{
+		const Node &node(nodes[find(i->first)]);
+
+		float lower_case((float).0);
+		for (Node::TSubTreeIt j(node.sub_trees.begin()); j != node.sub_trees.end(); ++j)
+			if (nodes[*j].c == (char)0)
+				lower_case += nodes[*j].prob;  // weights - trie is not finalized yet
+
+		const string *form(nullptr);
+		float         form_weight((float).0);
+		for (TSpellings::const_iterator j(i->second.begin()); j != i->second.end(); ++j)
+		{
+			lower_case -= j->second;
+			if (j->second > form_weight)
+			{
+				form        = &j->first;
+				form_weight = j->second;
+			}
+		}
+
+		if (form_weight > lower_case)
+			forms.add(i->first, *form);
+	}
+
 	finalize(0);
+	bound_attributes();
+
+	return f.size();
 }
 
-void TTrie::add(const string &s, const float &weight)
+void TTrie::add(const string &s, const float &weight, const uint64_t attributes)
 {
 	if (weight <= (float).0)
 		throw runtime_error("TTrie:add error: weight must be positive number");
 
 	sum_weight += weight;
-	add(0, s.begin(), s.end(), weight);
-}
 
-void TTrie::add(const size_t                 node_id, 
-	                  string::const_iterator begin, 
-				const string::const_iterator end, 
-				const float                  weight)
-{
-	if (begin == end)
+	// skip common prefix with previously added word
+	size_t depth(0);
+	if (!last_path.empty())
 	{
-		// check if inserted string is already in trie by checking if current node contains (char)0 subtree
-      	for (Node::TSubTreeIt i(nodes[node_id].sub_trees.begin()); i != nodes[node_id].sub_trees.end(); ++i)
-		   if (nodes[*i].c == (char)0)
-		   {
-			   nodes[*i].prob += weight;
-			   return;
-		   }
+		while (depth < s.size() && depth < last_word.size() && s[depth] == last_word[depth])
+			++depth;
 
-		// add new (char)0 delimited node in trie - denoting the end of word
-    	nodes[node_id].sub_trees.push_back(nodes.size());  // add new subtree in current node; note tha subtree is actually created at the next step
-		nodes.push_back(Node((char)0, weight));
-		return;
+		ascending = ascending && (depth == last_word.size() || (depth < s.size() && (unsigned char)s[depth] > (unsigned char)last_word[depth]));
 	}
- 
+
+	last_word = s;
+	last_path.resize(depth + 1);
+	last_path[0] = 0;
+
+	size_t node_id(last_path[depth]);
+	for (string::const_iterator i(s.begin() + depth); i != s.end(); ++i)
+	{
+		node_id = add(node_id, *i);
+		last_path.push_back(node_id);
+	}
+
+	// check if inserted string is already in trie by checking if current node contains (char)0 subtree with the same attributes
 	for (Node::TSubTreeIt i(nodes[node_id].sub_trees.begin()); i != nodes[node_id].sub_trees.end(); ++i)
-		if (nodes[*i].c == *begin)
+		if (nodes[*i].c == (char)0 && this->attributes(*i) == attributes)
 		{
-			add(*i, ++begin, end, weight);
+			nodes[*i].prob += weight;
 			return;
 		}
 
+	// add new (char)0 delimited node in trie - denoting the end of word; words with different attributes get separate end nodes
+	const size_t end(add_node((char)0, weight, attributes));
+	nodes[node_id].sub_trees.push_back(end);
+}
+
+uint64_t TTrie::attribute(const string &value) const
+{
+	for (size_t i(0); i < attribute_names.size(); ++i)
+		if (attribute_names[i] == value)
+			return (uint64_t)1 << i;
+
+	return 0;
+}
+
+// returns subtree of node labelled with c; subtree is created if it does not exist
+size_t TTrie::add(const size_t node_id, const char c)
+{
+	if (!ascending)  // otherwise c follows labels of subtrees
+		for (Node::TSubTreeIt i(nodes[node_id].sub_trees.begin()); i != nodes[node_id].sub_trees.end(); ++i)
+			if (nodes[*i].c == c)
+				return *i;
+
 	// insert new tree in subtree list
-	nodes[node_id].sub_trees.push_back(nodes.size());  // add new subtree at current node; note that subtree is actually created at the next step
-	nodes.push_back(Node(*begin, .0));  
-   	add(nodes[node_id].sub_trees.back(), ++begin, end, weight);
+	const size_t sub_tree(add_node(c, .0, 0));
+	nodes[node_id].sub_trees.push_back(sub_tree);
+	return sub_tree;
+}
+
+size_t TTrie::add_node(const char c, const float prob, const uint64_t attributes)
+{
+	nodes.push_back(Node(c, prob));
+	if (!masks.empty())
+		masks.push_back(attributes);
+
+	return nodes.size() - 1;
 }
 
 
@@ -138,10 +502,14 @@ void TTrie::finalize(const size_t node_id)
 
 	// finalize subtrees
 	nodes[node_id].prob = (float).0;
+	if (!masks.empty())
+		masks[node_id] = 0;
 	for (Node::TSubTreeIt i(nodes[node_id].sub_trees.begin()); i != nodes[node_id].sub_trees.end(); ++i)
     {
 		finalize(*i);
 		nodes[node_id].prob = max(nodes[node_id].prob, nodes[*i].prob);
+		if (!masks.empty())
+			masks[node_id] |= masks[*i];
 	}
 
 	// sort subtrees -- most probable are at the begining of nodes's subtree list
@@ -154,13 +522,369 @@ void TTrie::finalize(const size_t node_id)
 		
 		bool operator() (const size_t &lhs, const size_t &rhs) const 
 		{
-			return nodes[lhs].prob > nodes[rhs].prob; 
+			return nodes[lhs].prob > nodes[rhs].prob || (nodes[lhs].prob == nodes[rhs].prob && lhs < rhs);  // ties in order of labels (see load)
 		}
 	 } comparer(nodes);
 
 	sort(nodes[node_id].sub_trees.begin(), nodes[node_id].sub_trees.end(), comparer);
 }
 
+void TTrie::bound_attributes()
+{
+	for (vector<Node>::iterator i(nodes.begin()); i != nodes.end(); ++i)
+		i->bounded = false;
+
+	bound_offsets.clear();
+	bounds.clear();
+	if (masks.empty())
+		return;
+
+	// depth first traversal; word ends raise bounds of their attribute bits at bounded nodes on their path
+	vector<std::pair<size_t, unsigned int> > stack(1, std::make_pair((size_t)0, 0u));  // node, depth
+	size_t path[bounded_levels + 1];                                                   // bounded nodes on path
+	size_t offsets[bounded_levels + 1];
+
+	while (!stack.empty())
+	{
+		const size_t       node(stack.back().first);
+		const unsigned int depth(stack.back().second);
+		stack.pop_back();
+
+		if (depth <= bounded_levels)
+		{
+			const std::pair<unordered_map<size_t, size_t>::iterator, bool> offset(bound_offsets.insert(std::make_pair(node, bounds.size())));
+			if (offset.second)
+			{
+				nodes[node].bounded = true;
+				bounds.resize(bounds.size() + popcount(masks[node]), (float).0);
+			}
+
+			path[depth]    = node;
+			offsets[depth] = offset.first->second;
+		}
+
+		if (nodes[node].sub_trees.empty())
+			for (unsigned int level(0); level <= depth && level <= bounded_levels; ++level)
+				for (uint64_t bits(masks[node]); bits != 0; bits &= bits - 1)
+				{
+					float &bound(bounds[offsets[level] + popcount(masks[path[level]] & ((bits & (~bits + 1)) - 1))]);
+					bound = max(bound, nodes[node].prob);
+				}
+
+		for (Node::TSubTreeIt i(nodes[node].sub_trees.begin()); i != nodes[node].sub_trees.end(); ++i)
+			stack.push_back(std::make_pair(*i, depth + 1));
+	}
+}
+
+float TTrie::bound(const size_t index, const uint64_t filter) const
+{
+	const unordered_map<size_t, size_t>::const_iterator offset(bound_offsets.find(index));
+	float bound((float).0);
+	const float *b(bounds.data() + offset->second);
+	for (uint64_t bits(masks[index]); bits != 0; bits &= bits - 1, ++b)
+		if ((bits & (~bits + 1) & filter) != 0)
+			bound = max(bound, *b);
+
+	return bound;
+}
+
+
+size_t TTrie::find(const string &word) const
+{
+	size_t node_id(0);
+	for (string::const_iterator c(word.begin()); c != word.end(); ++c)
+	{
+		Node::TSubTreeIt i(nodes[node_id].sub_trees.begin());
+		while (i != nodes[node_id].sub_trees.end() && nodes[*i].c != *c)
+			++i;
+
+		if (i == nodes[node_id].sub_trees.end())
+			return nodes.size();
+
+		node_id = *i;
+	}
+
+	return node_id;
+}
+
+void TTrie::reorder(const vector<unsigned int> &hits)
+{
+	if (hits.size() != nodes.size())
+		throw runtime_error("TTrie::reorder - hits do not match trie size");
+
+	const size_t unassigned(nodes.size());
+	vector<size_t> position(nodes.size(), unassigned);  // new position of each node
+	vector<size_t> order;                               // old index of each node in new layout - used as BFS queue
+	order.reserve(nodes.size());
+
+	order.push_back(0);  // root stays at the beginning
+	position[0] = 0;
+
+	// first pass packs hot nodes, second pass appends cold nodes - both in BFS order
+	for (unsigned int pass(0); pass < 2; ++pass)
+		for (size_t i(0); i < order.size(); ++i)
+		{
+			const Node &node(nodes[order[i]]);
+			for (Node::TSubTreeIt j(node.sub_trees.begin()); j != node.sub_trees.end(); ++j)
+				if (position[*j] == unassigned && (pass > 0 || hits[*j] > 0))
+				{
+					position[*j] = order.size();
+					order.push_back(*j);
+				}
+		}
+
+	// subtree lists are allocated anew in the new node order; subtree order (by probability) is left intact
+	vector<Node>     reordered;
+	vector<uint64_t> reordered_masks;
+	reordered.reserve(order.size());
+	reordered_masks.reserve(masks.size());
+	for (vector<size_t>::const_iterator i(order.begin()); i != order.end(); ++i)
+	{
+		const Node &node(nodes[*i]);
+
+		reordered.push_back(Node(node.c, node.prob));
+		reordered.back().sub_trees.reserve(node.sub_trees.size());
+		for (Node::TSubTreeIt j(node.sub_trees.begin()); j != node.sub_trees.end(); ++j)
+			reordered.back().sub_trees.push_back(position[*j]);
+
+		if (!masks.empty())
+			reordered_masks.push_back(masks[*i]);
+	}
+
+	nodes.swap(reordered);
+	masks.swap(reordered_masks);
+	bound_attributes();
+}
+
+
+//
+// minimized nodes are registered by contents - node is identified by its index in the minimized node list
+//
+struct TNodeHash
+{
+	const vector<TTrie::Node> &nodes;
+	const vector<uint64_t>    &masks;  // empty if dictionary has no attributes
+
+	TNodeHash(const vector<TTrie::Node> &nodes, const vector<uint64_t> &masks)
+		: nodes(nodes), masks(masks) {}
+
+	size_t operator() (const size_t &id) const
+	{
+		const TTrie::Node &node(nodes[id]);
+
+		size_t h((unsigned char)node.c);
+		h = h * 1000003 ^ std::hash<float>()(node.prob);
+		if (!masks.empty())
+			h = h * 1000003 ^ std::hash<uint64_t>()(masks[id]);
+		for (TTrie::Node::TSubTreeIt i(node.sub_trees.begin()); i != node.sub_trees.end(); ++i)
+			h = h * 1000003 ^ *i;
+
+		return h;
+	}
+};
+
+struct TNodeEqual
+{
+	const vector<TTrie::Node> &nodes;
+	const vector<uint64_t>    &masks;
+
+	TNodeEqual(const vector<TTrie::Node> &nodes, const vector<uint64_t> &masks)
+		: nodes(nodes), masks(masks) {}
+
+	bool operator() (const size_t &lhs, const size_t &rhs) const
+	{
+		return nodes[lhs].c == nodes[rhs].c && nodes[lhs].prob == nodes[rhs].prob && 
+			   (masks.empty() || masks[lhs] == masks[rhs]) && nodes[lhs].sub_trees == nodes[rhs].sub_trees;
+	}
+};
+
+typedef unordered_set<size_t, TNodeHash, TNodeEqual> TNodeRegistry;
+
+// returns index of node in minimized node list; nodes are added in post order, masks along if trie has them
+size_t minimize(const vector<TTrie::Node> &nodes, const vector<uint64_t> &masks, const size_t node_id, 
+	            vector<TTrie::Node> &minimized, vector<uint64_t> &minimized_masks, TNodeRegistry &registry)
+{
+	TTrie::Node node(nodes[node_id].c, nodes[node_id].prob);
+	node.sub_trees.reserve(nodes[node_id].sub_trees.size());
+	for (TTrie::Node::TSubTreeIt i(nodes[node_id].sub_trees.begin()); i != nodes[node_id].sub_trees.end(); ++i)
+		node.sub_trees.push_back(minimize(nodes, masks, *i, minimized, minimized_masks, registry));
+
+	// node is tentatively added to be looked up - it is removed if equal node is already registered
+	minimized.push_back(TTrie::Node(node.c, node.prob));
+	minimized.back().sub_trees.swap(node.sub_trees);
+	if (!masks.empty())
+		minimized_masks.push_back(masks[node_id]);
+
+	std::pair<TNodeRegistry::const_iterator, bool> registered(registry.insert(minimized.size() - 1));
+	if (!registered.second)
+	{
+		minimized.pop_back();
+		if (!masks.empty())
+			minimized_masks.pop_back();
+	}
+
+	return *registered.first;
+}
+
+void TTrie::minimize()
+{
+	vector<Node>     minimized;
+	vector<uint64_t> minimized_masks;
+	TNodeRegistry    registry(nodes.size() / 4, TNodeHash(minimized, minimized_masks), TNodeEqual(minimized, minimized_masks));
+
+	::minimize(nodes, masks, 0, minimized, minimized_masks, registry);
+
+	// reverse post order - root is at the beginning and parents are before children
+	const size_t last(minimized.size() - 1);
+	vector<Node> reversed;
+	reversed.reserve(minimized.size());
+	for (vector<Node>::const_reverse_iterator i(minimized.rbegin()); i != minimized.rend(); ++i)
+	{
+		reversed.push_back(Node(i->c, i->prob));
+		reversed.back().sub_trees.reserve(i->sub_trees.size());
+		for (Node::TSubTreeIt j(i->sub_trees.begin()); j != i->sub_trees.end(); ++j)
+			reversed.back().sub_trees.push_back(last - *j);
+	}
+
+	nodes.swap(reversed);
+	masks.assign(minimized_masks.rbegin(), minimized_masks.rend());
+	bound_attributes();
+}
+
+size_t TTrie::memory() const
+{
+	size_t bytes(nodes.capacity() * sizeof(Node));
+	for (vector<Node>::const_iterator i(nodes.begin()); i != nodes.end(); ++i)
+		bytes += i->sub_trees.capacity() * sizeof(size_t);
+
+	return bytes + attribute_memory();
+}
+
+size_t TTrie::attribute_memory() const
+{
+	// hash map - bucket per slot, node with key, value and link per entry
+	return masks.capacity() * sizeof(uint64_t) + bounds.capacity() * sizeof(float) +
+		   bound_offsets.bucket_count() * sizeof(void *) + bound_offsets.size() * (2 * sizeof(size_t) + sizeof(void *));
+}
+
+TTrieStats::TTrieStats()
+	: nodes(0), tree_nodes(0), terminals(0), chains(0), chain_nodes(0), 
+	  label_bytes(0), probability_bytes(0), attribute_bytes(0), child_list_bytes(0), padding_bytes(0),
+	  minimized_nodes(0), minimized_bytes(0), louds_bytes(0), art_bytes(0)
+{
+}
+
+size_t TTrieStats::fanout_bucket(const size_t n_sub_trees)
+{
+	if (n_sub_trees <= 4)
+		return n_sub_trees;
+
+	size_t bucket(5);
+	for (size_t limit(8); bucket < n_fanout_buckets - 1 && n_sub_trees > limit; limit *= 2)
+		++bucket;
+
+	return bucket;
+}
+
+TTrieStats TTrie::stats() const
+{
+	TTrieStats stats;
+	stats.nodes = nodes.size();
+
+	// depth first traversal; shared subtries of minimized trie are visited at every occurrence
+	struct TVisit
+	{
+		size_t node, depth;
+		bool   in_chain;  // parent has a single subtree
+	};
+
+	size_t large_nodes(0);  // nodes with label map in TArtTrie
+
+	vector<TVisit> stack(1);
+	stack[0].node     = 0;
+	stack[0].depth    = 0;
+	stack[0].in_chain = false;
+
+	while (!stack.empty())
+	{
+		const TVisit visit(stack.back());
+		stack.pop_back();
+
+		const Node &node(nodes[visit.node]);
+
+		++stats.tree_nodes;
+		if (stats.depths.size() <= visit.depth)
+		{
+			stats.depths.resize(visit.depth + 1, 0);
+			stats.fanout.resize(visit.depth + 1, vector<size_t>(TTrieStats::n_fanout_buckets, 0));
+		}
+		++stats.depths[visit.depth];
+		++stats.fanout[visit.depth][TTrieStats::fanout_bucket(node.sub_trees.size())];
+
+		if (node.c == (char)0 && visit.depth > 0)  // word of length depth - 1
+		{
+			++stats.terminals;
+			if (stats.lengths.size() < visit.depth)
+				stats.lengths.resize(visit.depth, 0);
+			++stats.lengths[visit.depth - 1];
+		}
+
+		if (node.sub_trees.size() > TArtTrie::max_medium)
+			++large_nodes;
+
+		const bool single(node.sub_trees.size() == 1);
+		if (single)
+		{
+			++stats.chain_nodes;
+			if (!visit.in_chain)
+				++stats.chains;
+		}
+
+		for (Node::TSubTreeIt i(node.sub_trees.begin()); i != node.sub_trees.end(); ++i)
+		{
+			TVisit sub_tree;
+			sub_tree.node     = *i;
+			sub_tree.depth    = visit.depth + 1;
+			sub_tree.in_chain = single;
+			stack.push_back(sub_tree);
+		}
+	}
+
+	// memory by structure
+	stats.label_bytes       = nodes.size() * sizeof(char);
+	stats.probability_bytes = nodes.size() * sizeof(float);
+	stats.attribute_bytes   = attribute_memory();
+	stats.child_list_bytes  = nodes.size() * sizeof(vector<size_t>);
+	for (vector<Node>::const_iterator i(nodes.begin()); i != nodes.end(); ++i)
+		stats.child_list_bytes += i->sub_trees.capacity() * sizeof(size_t);
+	stats.padding_bytes = memory() - stats.label_bytes - stats.probability_bytes - stats.attribute_bytes - stats.child_list_bytes;
+
+	// minimized trie - equal subtries are counted once
+	{
+		vector<Node>     minimized;
+		vector<uint64_t> minimized_masks;
+		TNodeRegistry    registry(nodes.size() / 4, TNodeHash(minimized, minimized_masks), TNodeEqual(minimized, minimized_masks));
+
+		::minimize(nodes, masks, 0, minimized, minimized_masks, registry);
+
+		stats.minimized_nodes = minimized.size();
+		stats.minimized_bytes = minimized.size() * sizeof(Node) + minimized_masks.size() * sizeof(uint64_t);
+		for (vector<Node>::const_iterator i(minimized.begin()); i != minimized.end(); ++i)
+			stats.minimized_bytes += i->sub_trees.size() * sizeof(size_t);
+	}
+
+	// LOUDS - one 1 bit per edge and one 0 bit per node, 32 bit select sample per 64 nodes, byte label, 16 bit probability
+	// and dequantization table, attribute mask per node only if dictionary has attributes
+	const size_t n(stats.tree_nodes);
+	const size_t n_bits(2 * n - 1);
+	stats.louds_bytes = (n_bits / 64 + 1) * sizeof(uint64_t) + (n + 63) / 64 * sizeof(uint32_t) + n * (sizeof(char) + sizeof(uint16_t)) +
+		                (1 << 16) * sizeof(float) + (attribute_names.empty() ? 0 : n * sizeof(uint64_t));
+
+	// adaptive node kinds - fixed size node and label per node, label map per large node
+	stats.art_bytes = n * (sizeof(TArtTrie::TNode) + sizeof(char)) + 16 + large_nodes * 256 * sizeof(uint16_t) + (attribute_names.empty() ? 0 : n * sizeof(uint64_t));
+
+	return stats;
+}
 
 
 
@@ -168,7 +892,7 @@ void TTrie::finalize(const size_t node_id)
 /*******************
 *   TKeyboard      * 
 ********************/
-TKeyboard::TKeyboard()
+void TKeyboard::keys(set<Pos> positions[256])
 {
 
      /*
@@ -186,7 +910,7 @@ TKeyboard::TKeyboard()
 	string layout[n_rows] =
 	         {
                 "  `~ \1    1!      \1    2@  \1    3#    \1    4$    \1    5%    \1    6^      \1    7&    \1    8*    \1    9(    \1    0)      \1    -_         \1  =+        ", 
-                "     \1    Qq      \1    Ww  \1    Ee    \1    Rr    \1    Tt     \1    YyzZ    \1    Uu    \1    Ii    \1    Oo    \1    Op      \1   Ss[{      \1  Dd]}    ",
+                "     \1    Qq      \1    Ww  \1    Ee    \1    Rr    \1    Tt     \1    YyzZ    \1    Uu    \1    Ii    \1    Oo    \1    Pp      \1   Ss[{      \1  Dd]}    ",
                 "     \1    Aa      \1    Ss  \1    Dd    \1    Ff    \1    Gg     \1    Hh      \1    Jj    \1    Kk    \1    Ll    \1    Cc;:  \1    Cc'\"    \1  \\|Zz   ", 
                 "     \1    ZzYy    \1    Xx  \1    Cc    \1    Vv    \1    Bb     \1    Nn      \1    Mm    \1    ,<    \1    .>    \1    /?      \1               \1            ",
                 "     \1            \1        \1    \2    \1    \2    \1    \2     \1    \2      \1    \2    \1    \2    \1    \2    \1            \1               \1            "  
@@ -203,13 +927,33 @@ TKeyboard::TKeyboard()
 				++col;
 
 			if (line[j] == spacebar) // encoded space character
-					keyboard[(unsigned char)' '].insert(Pos(row, col));
+					positions[(unsigned char)' '].insert(Pos(row, col));
 			else
 			if (line[j] != ' ')
-				keyboard[(unsigned char)line[j]].insert(Pos(row, col));
+				positions[(unsigned char)line[j]].insert(Pos(row, col));
 		}
 	}
+}
+
+TKeyboard::TKeyboard()
+{
+	set<Pos> positions[256];
+	keys(positions);
+
+	typedef set<Pos>::const_iterator TIt;
 
+	// min hamming distance of key positions
+	for (unsigned int p(0); p < 256; ++p)
+		for (unsigned int q(0); q < 256; ++q)
+		{
+			unsigned int result(off_keyboard);  // taking care for off keyboard characters
+
+			for (TIt ip(positions[p].begin()); ip != positions[p].end(); ++ip)
+				for (TIt iq(positions[q].begin()); iq != positions[q].end(); ++iq)
+					result = min(result, distance(*ip, *iq));
+
+			distances[p][q] = (unsigned char)result;
+		}
 }
 
 
@@ -225,22 +969,60 @@ unsigned int TKeyboard::distance(const Pos &p, const Pos &q)
 	return result;
 }
 
-unsigned int TKeyboard::distance(const unsigned char p, const unsigned char q)
+
+TReferenceKeyboard::TReferenceKeyboard()
+{
+	keys(positions);
+}
+
+unsigned int TReferenceKeyboard::distance(const unsigned char p, const unsigned char q) const
 {
 	// taking care for off keyboard characters
-    unsigned int result(20);
+	unsigned int result(off_keyboard);
 
-	if (keyboard[p].empty() || keyboard[q].empty())
-	   return result;
+	if (positions[p].empty() || positions[q].empty())
+		return result;
 
-   typedef set<Pos>::const_iterator TIt;
+	typedef set<Pos>::const_iterator TIt;
 
-   // find min hamming distance
-   for (TIt ip(keyboard[p].begin()); ip != keyboard[p].end(); ++ip)
-      for (TIt iq(keyboard[q].begin()); iq != keyboard[q].end(); ++iq)
-		  result = min(result, distance(*ip, *iq));
+	// find min hamming distance
+	for (TIt ip(positions[p].begin()); ip != positions[p].end(); ++ip)
+		for (TIt iq(positions[q].begin()); iq != positions[q].end(); ++iq)
+			result = min(result, TKeyboard::distance(*ip, *iq));
 
-   return result;
+	return result;
+}
+
+const float TReferenceErrors::keypress_error = (float).05;
+
+const float TReferenceErrors::insertion     = (float).16;
+const float TReferenceErrors::substitution  = (float).17;
+const float TReferenceErrors::deletion      = (float).60;
+const float TReferenceErrors::transposition = (float).06;
+
+const float TReferenceErrors::begin_insertion_penalty    = (float).05;
+const float TReferenceErrors::begin_substitution_penalty = (float).1;
+const float TReferenceErrors::first_deletion_penalty     = (float).05;
+const float TReferenceErrors::second_deletion_penalty    = (float).1;
+
+const unsigned int TReferenceErrors::near_key_distance    = 2;
+const float        TReferenceErrors::far_deletion_penalty = (float).25;
+
+float TReferenceErrors::transition(const unsigned int distance)
+{
+	if (distance == 0)
+		return (float).95;
+	else
+	if (distance == 1)
+		return (float).1;
+	else
+	if (distance < 4)
+		return (float).05;
+	else
+	if (distance < 8)
+		return (float).0025;
+	else
+		return (float).00005;
 }
 
 
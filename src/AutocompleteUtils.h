@@ -18,6 +18,8 @@ IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 // auxilliary structs for TAutocomplete class
 
+#include <stdint.h>
+
 #include <string>
 using std::string;
 
@@ -27,12 +29,76 @@ using std::vector;
 #include <set>
 using std::set;
 
+#include <unordered_map>
+using std::unordered_map;
+
+struct TTrieStats;
+
+// lower case copy of word (ASCII letters); false if word has no upper case letters
+bool fold_case(const string &word, string &folded);
+
+// index of lowest set bit (x != 0) and cache prefetch hint; MSVC has no __builtin functions
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <xmmintrin.h>
+inline unsigned int ctz(const uint64_t x)               { unsigned long i; _BitScanForward64(&i, x); return i; }
+inline unsigned int popcount(const uint64_t x)          { return (unsigned int)__popcnt64(x); }
+inline void         prefetch_memory(const void *address) { _mm_prefetch((const char *)address, _MM_HINT_T0); }
+#else
+inline unsigned int ctz(const uint64_t x)               { return __builtin_ctzll(x); }
+inline unsigned int popcount(const uint64_t x)          { return __builtin_popcountll(x); }
+inline void         prefetch_memory(const void *address) { __builtin_prefetch(address); }
+#endif
+
+
+//
+//  TDisplayForms - spelling of words of case folded dictionary (see TTrie::Format::fold_case)
+//    - words are stored in lower case; the most weighted spelling of a word is displayed
+//    - only words displayed differently than stored are kept
+//
+
+class TDisplayForms
+{
+    public:
+
+		typedef unordered_map<string, string>::const_iterator TIt;
+
+		void add(const string &word, const string &form) { forms[word] = form; };
+
+		// replace stored word by its display form
+		void display(string &word) const
+		{
+			if (forms.empty())
+				return;
+
+			TIt i(forms.find(word));
+			if (i != forms.end())
+				word = i->second;
+		}
+
+		const string *find(const string &word) const { TIt i(forms.find(word)); return i == forms.end() ? nullptr : &i->second; };
+
+		TIt    begin() const { return forms.begin(); };
+		TIt    end() const   { return forms.end(); };
+		size_t size() const  { return forms.size(); };
+		size_t memory() const;  // bytes
+
+		void clear() { forms.clear(); };
+
+    private:
+
+		unordered_map<string, string> forms;  // stored word -> display form
+};
+
+
 //
 //  TTrie
 //    - words in trie are weighted 
 //    - (char)0 is reserved for word terminator in Trie
 //    - nodes in trie are weighted by max subtree word
 //    - node subtrees are stored in descending order by weight
+//    - words can carry attribute bits (e.g. country); nodes hold OR of attributes of subtree words in a side array,
+//      nodes of first levels also max probability of subtree words per attribute bit
 
 class TTrie
 {
@@ -40,14 +106,35 @@ class TTrie
 
 		TTrie();
 
-		void load(const string file_name);
+		// dictionary file layout - default is "weight word" per line
+		struct Format
+		{
+			Format()
+				: delimiter(' '), weight_column(0), word_column(1), attribute_column(no_column), default_weight(.0), header(false),
+				  fold_case(false) {}
+
+			static const unsigned int no_column = 0xffffffff;
+
+			char          delimiter;         // field delimiter (no quoting)
+			unsigned int  weight_column;     // 0 based index of weight field
+			unsigned int  word_column;       // 0 based index of word field; if it is the last field it extends to the end of line
+			                                 // (of header line; without header: if it follows weight and attribute fields)
+			unsigned int  attribute_column;  // 0 based index of '|' separated attribute values; no_column -> words have no attributes
+			float         default_weight;  // weight of entries with empty weight field; .0 -> empty weight is an error
+			bool          header;          // skip the first line
+			bool          fold_case;       // store words in lower case (ASCII), so spellings share nodes (see TDisplayForms)
+		};
+
+		// load plain or gzip compressed dictionary; returns number of (uncompressed) bytes read
+		size_t load(const string file_name, const Format &format = Format());
 
 		struct Node
 		{
 			Node(char c, float prob)
-				: c(c), prob(prob) {}
+				: c(c), bounded(false), prob(prob) {}
 
 			char           c;            // Node character
+			bool           bounded;      // max probabilities per attribute bit are kept (see bound_offsets); fits in padding
 			float          prob;         // probability of the most frequent word in trie rooted at Node
 			vector<size_t> sub_trees;    
 
@@ -56,34 +143,154 @@ class TTrie
 		
 		Node &root() { return nodes[0]; };
 		Node &node(const size_t index) { return nodes[index]; };
+		const Node &node(const size_t index) const { return nodes[index]; };
+
+		size_t size() const { return nodes.size(); };
+		size_t memory() const;            // bytes used by nodes
+		size_t attribute_memory() const;  // of these, bytes used by attribute masks and bounds
+
+		// shape and memory breakdown of trie with footprint estimates of alternative layouts (see TTrieStats)
+		TTrieStats stats() const;
+
+		// node access used by TBasicAutocomplete - nodes are referenced by pointer, subtrees by index
+		typedef const Node       *TNodeRef;
+		typedef Node::TSubTreeIt  TSubTreeIt;
+
+		TNodeRef ref(const size_t index) const { return &nodes[index]; };
+		size_t   index(const TNodeRef node) const { return node - &nodes[0]; };
+
+		size_t   roots() const              { return 1; };  // search starts at every root
+		size_t   root(const size_t) const   { return 0; };
+
+		char     label(const size_t index) const      { return nodes[index].c; };
+		float    prob(const size_t index) const       { return nodes[index].prob; };
+		uint64_t attributes(const size_t index) const { return masks.empty() ? 0 : masks[index]; };
+
+		// probability of the most frequent word in trie rooted at node among words with any of filter attributes; above
+		// prob(index) only at the first bounded_levels levels
+		float prob(const size_t index, const uint64_t filter) const { return nodes[index].bounded ? bound(index, filter) : nodes[index].prob; };
+
+		static char       label(const TNodeRef node) { return node->c; };
+		static float      prob(const TNodeRef node)  { return node->prob; };
+		static TSubTreeIt begin(const TNodeRef node) { return node->sub_trees.begin(); };
+		static TSubTreeIt end(const TNodeRef node)   { return node->sub_trees.end(); };
+
+		// node will be expanded soon (interleaved search) - fetch its first subtrees into cache
+		static const size_t prefetch_sub_trees = 8;
+		void prefetch(const TNodeRef node) const
+		{
+			const size_t n(node->sub_trees.size() < prefetch_sub_trees ? node->sub_trees.size() : prefetch_sub_trees);
+			for (size_t k(0); k < n; ++k)
+				prefetch_memory(&nodes[node->sub_trees[k]]);
+		}
+
+		// attribute bit of dictionary attribute value (see Format::attribute_column); 0 if value does not occur in dictionary
+		uint64_t attribute(const string &value) const;
+		static const uint64_t any_attribute = ~(uint64_t)0;  // search filter accepting all words, including words without attributes
+		const vector<string> &attribute_values() const { return attribute_names; };  // value of bit i is at index i
+
+		// spelling of words of case folded dictionary; suggestion is displayed as word (path to terminal node)
+		const TDisplayForms &display_forms() const { return forms; };
+		void display(const TNodeRef, string &word) const { forms.display(word); };
+
+		// renumber nodes: nodes with hits > 0 are packed at the beginning in BFS order, followed by the rest in BFS order
+		void reorder(const vector<unsigned int> &hits);
+
+		// merge equal subtries (same characters, weights and subtree order) into minimal acyclic automaton
+		//    - suffixes shared by words with equal weights are stored once; search over trie is not affected
+		//    - trie can not be extended afterwards
+		void minimize();
 
     private:
 
-		vector<Node>  nodes;
-		float         sum_weight;
+		friend class TBenchTrie;  // building blocks are benchmarked in isolation (demo/bench.cpp)
+
+		vector<Node>     nodes;
+		vector<uint64_t> masks;  // OR of attributes of words in trie rooted at node; empty if dictionary has no attributes
+		float            sum_weight;
+		vector<string>   attribute_names;  // at most 64 distinct attribute values
+		TDisplayForms    forms;
+
+		// max probability of subtree words per attribute bit of node (in order of bits of its mask) at first levels;
+		// filtered search is bounded by words it can suggest instead of the most frequent word of subtree
+		static const unsigned int     bounded_levels = 4;
+		unordered_map<size_t, size_t> bound_offsets;  // node -> its first bound
+		vector<float>                 bounds;
+
+		string         last_word;  // previously added word and its path in trie - consecutive words in sorted dictionaries share prefixes
+		vector<size_t> last_path;
+		bool           ascending;  // words were added in ascending order - a new subtree can not have a label of existing one
 
-		void add(const string &s, const float &weight);
-		void add(const size_t node_id, string::const_iterator begin,  const string::const_iterator end,  const float weight);
+		void add(const string &s, const float &weight, const uint64_t attributes);
+		size_t add(const size_t node_id, const char c);
+		size_t add_node(const char c, const float prob, const uint64_t attributes);
 		void finalize(const size_t node_id);
+		void bound_attributes();  // bounds of first levels (see bound_offsets)
+		float bound(const size_t index, const uint64_t filter) const;
+		size_t find(const string &word) const;  // node of word; size() if word is not in trie
+};
+
+
+//
+//  TTrieStats - for capacity planning
+//    - shape is measured on trie as seen by search: subtries shared by minimized trie are counted at every occurrence
+//    - memory of TTrie is split by structure; parts add up to TTrie::memory()
+//    - alternative layouts: minimized trie is counted exactly, TLoudsTrie and TArtTrie sizes follow from their encoding
+//
+
+struct TTrieStats
+{
+	TTrieStats();
+
+	static const size_t n_fanout_buckets = 9;  // number of subtrees: 0, 1, 2, 3, 4, 5-8, 9-16, 17-32, 33+
+	static size_t fanout_bucket(const size_t n_sub_trees);
+
+	size_t nodes;        // stored nodes
+	size_t tree_nodes;   // nodes of trie as seen by search
+	size_t terminals;    // word ends ((char)0 nodes)
+	size_t chains;       // maximal paths of nodes with a single subtree - candidates for path compression
+	size_t chain_nodes;  // nodes on such paths
+
+	vector<size_t>          depths;   // nodes per depth; root is at depth 0
+	vector<size_t>          lengths;  // words per length
+	vector<vector<size_t> > fanout;   // fanout[depth][bucket] - nodes at depth by number of subtrees
+
+	// bytes of TTrie by structure
+	size_t label_bytes;
+	size_t probability_bytes;
+	size_t attribute_bytes;
+	size_t child_list_bytes;  // subtree vectors and their capacity
+	size_t padding_bytes;     // alignment in nodes and spare capacity of node vector
+
+	// estimated bytes of alternative layouts
+	size_t minimized_nodes;
+	size_t minimized_bytes;  // TTrie::minimize
+	size_t louds_bytes;      // TLoudsTrie::build
+	size_t art_bytes;        // TArtTrie::build
 };
 
 
 //
 //  state information for autocomplete search
+//    - TIndex is trie representation searched (TTrie, TLoudsTrie)
 //
 
-struct TAction // action performed on candidate node
+template <class TIndex>
+struct TBasicAction // action performed on candidate node
 {
+	typedef typename TIndex::TNodeRef   TNodeRef;
+	typedef typename TIndex::TSubTreeIt TSubTreeIt;
+
 	enum operation_t {insert_char, no_correction, substitute_char, delete_char, transpose_char, no_op}  // order in enum important -> TCandidate constructor depends on it
 		      operation;
 
-	TAction(TTrie::Node &node, const operation_t &operation, const TTrie::Node::TSubTreeIt &sub_tree)
-			: node(&node), operation(operation), sub_tree(sub_tree) {}
+	TBasicAction(const TNodeRef &node, const operation_t &operation, const TSubTreeIt &sub_tree)
+			: operation(operation), node(node), sub_tree(sub_tree) {}
 
-	TTrie::Node             *node;
-	TTrie::Node::TSubTreeIt sub_tree;
+	TNodeRef    node;
+	TSubTreeIt  sub_tree;
 
-    TAction& operator=(const TAction &rhs)
+    TBasicAction& operator=(const TBasicAction &rhs)
     {
 		if (this != &rhs)
 		{
@@ -95,19 +302,24 @@ struct TAction // action performed on candidate node
 		return *this;
     }
 
-	bool operator!=(const TAction &rhs) const
+	bool operator!=(const TBasicAction &rhs) const
     {
 		return operation != rhs.operation || node != rhs.node || sub_tree != rhs.sub_tree;	
 	}
 
-    TAction& operator++()
+	bool operator==(const TBasicAction &rhs) const
+    {
+		return !(*this != rhs);
+	}
+
+    TBasicAction& operator++()
 	{
 		if (operation == delete_char    ||  // one time operation on node - no iteration over subtrees needed
 			operation == transpose_char ||  // one time operation on node - no iteration over subtrees needed 
-			sub_tree == node->sub_trees.end() || ++sub_tree == node->sub_trees.end() )
+			sub_tree == TIndex::end(node) || ++sub_tree == TIndex::end(node) )
 		{
 			operation = static_cast<operation_t>(operation + 1);
-			sub_tree  = node->sub_trees.begin();
+			sub_tree  = TIndex::begin(node);
 		} 
 
 		return *this;
@@ -115,48 +327,69 @@ struct TAction // action performed on candidate node
 };
 
 
-struct TCandidate
+template <class TIndex>
+struct TBasicCandidate
 {
-	TCandidate(      TTrie::Node             &node, 
-		       const TAction                 &begin,
-	           const TAction                 &end,
-	           const string::const_iterator  &query,
-	           const string                  &suggestion,
-	           const float                   &query_probability,
-	           const unsigned int            &n_errors)
-		  	     : node(&node), begin(begin), end(end),  query(query), suggestion(suggestion), 
-			 	   query_probability(query_probability), probability(query_probability * node.prob), 
+	typedef typename TIndex::TNodeRef TNodeRef;
+	typedef TBasicAction<TIndex>      TAction;
+
+	TBasicCandidate(const TNodeRef                &node, 
+		            const TAction                 &begin,
+	                const TAction                 &end,
+	                const string::const_iterator  &query,
+	                const string                  &suggestion,
+	                const float                   &query_probability,
+	                const unsigned int            &n_errors)
+		  	     : node(node), begin(begin), end(end),  query(query), suggestion(suggestion), 
+			 	   query_probability(query_probability), probability(query_probability * TIndex::prob(node)), 
 				   n_errors(n_errors) { }
 				   
-	TCandidate(      TTrie::Node             &node, 
-		       const TAction                 &begin,
-	           const TAction                 &end,
-	           const string::const_iterator  &query,
-	           const string                  &suggestion,
-	           const float                   &query_probability,
-	           const float                   &probability,
-	           const unsigned int            &n_errors)
-		  	     : node(&node), begin(begin), end(end),  query(query), suggestion(suggestion), 
+	TBasicCandidate(const TNodeRef                &node, 
+		            const TAction                 &begin,
+	                const TAction                 &end,
+	                const string::const_iterator  &query,
+	                const string                  &suggestion,
+	                const float                   &query_probability,
+	                const float                   &probability,
+	                const unsigned int            &n_errors)
+		  	     : node(node), begin(begin), end(end),  query(query), suggestion(suggestion), 
 			 	   query_probability(query_probability), probability(probability), 
 				   n_errors(n_errors) { }
 
-	TCandidate(      TTrie::Node             &node, 
-	           const string::const_iterator  &query,
-	           const string                  &suggestion,
-	           const float                   &query_probability,
-	           const unsigned int            &n_errors)
-		  	     : node(&node), 
-				   begin(node, TAction::insert_char, node.sub_trees.begin()), // first possible action
-				   end(node,   TAction::no_op, node.sub_trees.begin()),  // last possible action
+	TBasicCandidate(const TNodeRef                &node, 
+	                const string::const_iterator  &query,
+	                const string                  &suggestion,
+	                const float                   &query_probability,
+	                const unsigned int            &n_errors)
+		  	     : node(node), 
+				   begin(node, TAction::insert_char, TIndex::begin(node)), // first possible action
+				   end(node,   TAction::no_op, TIndex::begin(node)),  // last possible action
+				   query(query), suggestion(suggestion), 
+			 	   query_probability(query_probability), probability(query_probability * TIndex::prob(node)), 
+				   n_errors(n_errors) 
+	           { 
+				   if (TIndex::begin(node) == TIndex::end(node))  // specila case of empty sub_tree
+				      begin = end;
+               }
+
+	TBasicCandidate(const TNodeRef                &node, 
+	                const string::const_iterator  &query,
+	                const string                  &suggestion,
+	                const float                   &query_probability,
+	                const float                   &probability,
+	                const unsigned int            &n_errors)
+		  	     : node(node), 
+				   begin(node, TAction::insert_char, TIndex::begin(node)), // first possible action
+				   end(node,   TAction::no_op, TIndex::begin(node)),  // last possible action
 				   query(query), suggestion(suggestion), 
-			 	   query_probability(query_probability), probability(query_probability * node.prob), 
+			 	   query_probability(query_probability), probability(probability), 
 				   n_errors(n_errors) 
 	           { 
-				   if (node.sub_trees.begin() == node.sub_trees.end())  // specila case of empty sub_tree
+				   if (TIndex::begin(node) == TIndex::end(node))  // specila case of empty sub_tree
 				      begin = end;
                }
 
-    TTrie::Node              *node;
+    TNodeRef                 node;
 	TAction                  begin;
 	TAction                  end;
 	string::const_iterator   query;
@@ -166,7 +399,7 @@ struct TCandidate
 	unsigned int             n_errors;  // currently not used - might be useful for alternative error probability distrubutions
 
 
-	TCandidate& operator=(const TCandidate &rhs)
+	TBasicCandidate& operator=(const TBasicCandidate &rhs)
 	{
 		if (this != &rhs)
 		{
@@ -183,16 +416,24 @@ struct TCandidate
 		return *this;
 	}
 
-	bool operator<(const TCandidate &rhs) const
+	bool operator<(const TBasicCandidate &rhs) const
 	{  
 		return probability < rhs.probability;
 	}
 };
 
+typedef TBasicAction<TTrie>    TAction;
+typedef TBasicCandidate<TTrie> TCandidate;
+
+
+//
+//  TKeyboard - default keyboard layout policy of TBasicAutocomplete
+//    - distances of all character pairs are computed once, distance(...) is a table lookup
+//
 
 class TKeyboard
 {
-    private:
+    protected:
 
 	   struct Pos  // position of a key on the keyboard
 	   {
@@ -233,15 +474,105 @@ class TKeyboard
 		   }
        };
 	   
-	   set<Pos> keyboard[255];  // array of positions of characters in keyboard 
+	   static void keys(set<Pos> positions[256]);  // positions of characters on the layout
+	   static unsigned int distance(const Pos &p, const Pos &q);
 
-	   unsigned int distance(const Pos &p, const Pos &q);
+    private:
+
+	   unsigned char distances[256][256];
 
     public:
 
 		TKeyboard();
 
-		unsigned int distance(const unsigned char p, const unsigned char q);
+		static const unsigned int off_keyboard = 20;  // distance to characters that are not on the keyboard
+
+		unsigned int distance(const unsigned char p, const unsigned char q) const { return distances[p][q]; };
+};
+
+
+//
+//  TTypingErrors - default error model policy of TBasicAutocomplete (see error modelling in Autocomplete.cpp)
+//    - probabilities are compile time constants
+//
+
+struct TTypingErrors
+{
+	static constexpr float keypress_error = (float).05;  // per-key pressed probability of error
+
+	// error type probabilities given an error
+	static constexpr float insertion     = (float).16;  // 16% deletion errors -> 16% insertion prob
+	static constexpr float substitution  = (float).17;
+	static constexpr float deletion      = (float).60;  // 60% insertion errors -> 60% deletion prob
+	static constexpr float transposition = (float).06;
+
+	// errors at the beginning of query are less likely
+	static constexpr float begin_insertion_penalty    = (float).05;
+	static constexpr float begin_substitution_penalty = (float).1;
+	static constexpr float first_deletion_penalty     = (float).05;
+	static constexpr float second_deletion_penalty    = (float).1;
+
+	// inserted characters are usually near the intended key
+	static constexpr unsigned int near_key_distance    = 2;
+	static constexpr float        far_deletion_penalty = (float).25;
+
+	// probability of typing a character at keyboard distance from the intended one
+	static float transition(const unsigned int distance)
+	{
+		if (distance == 0)
+			return (float).95;
+
+		if (distance == 1)
+			return (float).1;
+
+		if (distance < 4)
+			return (float).05;
+
+		if (distance < 8)
+			return (float).0025;
+
+		return (float).00005;
+	}
+};
+
+
+//
+//  TReferenceKeyboard, TReferenceErrors - the same layout and error model evaluated at run time, as before they were
+//  compile time policies: distance(...) searches key positions, constants are defined in AutocompleteUtils.cpp; only
+//  for checking that TKeyboard and TTypingErrors do not change suggestions (see TReferenceAutocomplete, replay -e)
+//
+
+class TReferenceKeyboard : public TKeyboard
+{
+    private:
+
+	   set<Pos> positions[256];
+
+    public:
+
+		TReferenceKeyboard();
+
+		unsigned int distance(const unsigned char p, const unsigned char q) const;
+};
+
+struct TReferenceErrors
+{
+	static const float keypress_error;
+
+	static const float insertion;
+	static const float substitution;
+	static const float deletion;
+	static const float transposition;
+
+	static const float begin_insertion_penalty;
+	static const float begin_substitution_penalty;
+	static const float first_deletion_penalty;
+	static const float second_deletion_penalty;
+
+	static const unsigned int near_key_distance;
+	static const float        far_deletion_penalty;
+
+	static float transition(const unsigned int distance);
 };
 
 
@@ -0,0 +1,101 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "FederatedTrie.h"
+
+#include <stdexcept>
+using std::runtime_error;
+
+TFederatedTrie::TFederatedTrie()
+{
+}
+
+size_t TFederatedTrie::load(const string &name, const string &file_name, const float prior, const TTrie::Format &format)
+{
+	if (tries.size() == 64)
+		throw runtime_error("TFederatedTrie::load - more than 64 dictionaries");
+
+	if (attribute(name) != 0)
+		throw runtime_error("TFederatedTrie::load - duplicate dictionary " + name);
+
+	if (!(prior > .0))
+		throw runtime_error("TFederatedTrie::load - prior of dictionary " + name + " must be positive");
+
+	const size_t offset(size());
+	tries.push_back(TTrie());
+
+	size_t bytes;
+	try
+	{
+		bytes = tries.back().load(file_name, format);
+	}
+	catch (...)
+	{
+		tries.pop_back();
+		throw;
+	}
+
+	offsets.push_back(offset);
+	priors.push_back(prior);
+	names.push_back(name);
+
+	return bytes;
+}
+
+size_t TFederatedTrie::dictionary(const size_t index) const
+{
+	size_t d(offsets.size() - 1);
+	while (offsets[d] > index)
+		--d;
+
+	return d;
+}
+
+TFederatedTrie::TNodeRef TFederatedTrie::ref(const size_t index) const
+{
+	const size_t d(dictionary(index));
+
+	TNodeRef node;
+	node.node   = &tries[d].node(index - offsets[d]);
+	node.id     = index;
+	node.offset = offsets[d];
+	node.prior  = priors[d];
+
+	return node;
+}
+
+size_t TFederatedTrie::size() const
+{
+	return offsets.empty() ? 0 : offsets.back() + tries.back().size();
+}
+
+size_t TFederatedTrie::memory() const
+{
+	size_t bytes(0);
+	for (deque<TTrie>::const_iterator i(tries.begin()); i != tries.end(); ++i)
+		bytes += i->memory();
+
+	return bytes;
+}
+
+uint64_t TFederatedTrie::attribute(const string &name) const
+{
+	for (size_t i(0); i < names.size(); ++i)
+		if (names[i] == name)
+			return (uint64_t)1 << i;
+
+	return 0;
+}
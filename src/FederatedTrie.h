@@ -0,0 +1,122 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+using std::vector;
+
+#include <deque>
+using std::deque;
+
+#include "AutocompleteUtils.h"
+
+//
+//  TFederatedTrie
+//    - several dictionaries (e.g. cities, streets, places) searched as one index
+//    - every dictionary has its own trie and root; node ids of dictionaries are concatenated
+//    - probabilities of dictionary nodes are scaled by prior probability of dictionary, so a single search
+//      ranks and prunes words of all dictionaries together
+//    - attribute of a word is the bit of its dictionary - search filter selects dictionaries (at most 64)
+//
+
+class TFederatedTrie
+{
+    public:
+
+		TFederatedTrie();
+
+		// load plain or gzip compressed dictionary; returns number of (uncompressed) bytes read
+		size_t load(const string &name, const string &file_name, const float prior, const TTrie::Format &format = TTrie::Format());
+
+		// node reference caches dictionary of node
+		struct TNodeRef
+		{
+			TNodeRef()
+				: node(nullptr), id(0), offset(0), prior(.0) {}
+
+			const TTrie::Node *node;
+			size_t             id;      // node id in federated index
+			size_t             offset;  // id of dictionary root
+			float              prior;
+
+			bool operator!=(const TNodeRef &rhs) const { return node != rhs.node; }
+		};
+
+		class TSubTreeIt  // maps subtree ids of dictionary trie to federated ids
+		{
+		    public:
+				TSubTreeIt()
+					: offset(0) {}
+
+				TSubTreeIt(const TTrie::TSubTreeIt &i, const size_t offset)
+					: i(i), offset(offset) {}
+
+				size_t      operator*() const                         { return offset + *i; }
+				TSubTreeIt& operator++()                              { ++i; return *this; }
+				bool        operator==(const TSubTreeIt &rhs) const   { return i == rhs.i; }
+				bool        operator!=(const TSubTreeIt &rhs) const   { return i != rhs.i; }
+
+		    private:
+				TTrie::TSubTreeIt i;
+				size_t            offset;
+		};
+
+		// node access used by TBasicAutocomplete
+		TNodeRef ref(const size_t index) const;
+		size_t   index(const TNodeRef &node) const { return node.id; };
+
+		size_t   roots() const                  { return tries.size(); };
+		size_t   root(const size_t i) const     { return offsets[i]; };
+
+		char     label(const size_t index) const      { const size_t d(dictionary(index)); return tries[d].label(index - offsets[d]); };
+		float    prob(const size_t index) const       { const size_t d(dictionary(index)); return priors[d] * tries[d].prob(index - offsets[d]); };
+		uint64_t attributes(const size_t index) const { return (uint64_t)1 << dictionary(index); };
+		float    prob(const size_t index, const uint64_t) const { return prob(index); };  // no bounds per attribute
+
+		static char       label(const TNodeRef &node) { return node.node->c; };
+		static float      prob(const TNodeRef &node)  { return node.prior * node.node->prob; };
+		static TSubTreeIt begin(const TNodeRef &node) { return TSubTreeIt(node.node->sub_trees.begin(), node.offset); };
+		static TSubTreeIt end(const TNodeRef &node)   { return TSubTreeIt(node.node->sub_trees.end(), node.offset); };
+
+		// see TTrie::prefetch; nodes of dictionary are consecutive, starting at its root
+		static void prefetch(const TNodeRef &node)
+		{
+			const TTrie::Node *nodes(node.node - (node.id - node.offset));
+			const size_t       n(node.node->sub_trees.size() < TTrie::prefetch_sub_trees ? node.node->sub_trees.size() : TTrie::prefetch_sub_trees);
+			for (size_t k(0); k < n; ++k)
+				prefetch_memory(nodes + node.node->sub_trees[k]);
+		}
+
+		size_t size() const;
+		size_t memory() const;
+
+		uint64_t attribute(const string &name) const;  // bit of dictionary; 0 if there is no such dictionary
+
+		void display(const TNodeRef &node, string &word) const { tries[dictionary(node.id)].display_forms().display(word); };  // see TTrie::display
+		const vector<string> &dictionaries() const { return names; };
+
+    private:
+
+		deque<TTrie>   tries;    // deque keeps tries in place when dictionaries are added
+		vector<size_t> offsets;  // id of root of each dictionary
+		vector<float>  priors;
+		vector<string> names;
+
+		size_t dictionary(const size_t index) const;
+};
@@ -0,0 +1,467 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Ipc.h"
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include <algorithm>
+using std::min;
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace ipc;
+
+const unsigned int spins = 100;  // yields before sleeping
+
+// sleep while word == value, at most timeout_ms
+void sleep_on(std::atomic<uint32_t> &word, const uint32_t value, const long timeout_ms)
+{
+#ifdef __linux__
+	struct timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000};
+	syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAIT, value, &timeout, nullptr, 0);  // not private - word is shared among processes
+#else
+	if (word.load() == value)
+		usleep(50);
+#endif
+}
+
+void wake(std::atomic<uint32_t> &word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+// wait until ready() holds; producer changes word after making consumer ready and wakes it if waiting is set
+template <class TReady, class TAlive>
+void wait_until(std::atomic<uint32_t> &word, std::atomic<uint32_t> &waiting, TReady ready, TAlive alive)
+{
+	for (unsigned int i(0); i < spins; ++i)
+	{
+		if (ready())
+			return;
+
+		std::this_thread::yield();
+	}
+
+	for (;;)
+	{
+		uint32_t value(word.load());
+		waiting.store(1);
+		if (ready())
+			break;
+
+		sleep_on(word, value, 100);
+		if (!alive())
+			break;
+	}
+
+	waiting.store(0);
+}
+
+bool push(TRing &ring, const char *data, const uint32_t size)
+{
+	uint32_t head(ring.head.load(std::memory_order_relaxed));
+	if (head - ring.tail.load(std::memory_order_acquire) == ring_capacity)
+		return false;
+
+	TSlot &slot(ring.slots[head % ring_capacity]);
+	slot.size = size;
+	memcpy(slot.data, data, size);
+
+	ring.head.store(head + 1);
+	if (ring.waiting.load())
+		wake(ring.head);
+
+	return true;
+}
+
+const TSlot *front(TRing &ring)
+{
+	uint32_t tail(ring.tail.load(std::memory_order_relaxed));
+	return tail == ring.head.load(std::memory_order_acquire) ? nullptr : &ring.slots[tail % ring_capacity];
+}
+
+void pop(TRing &ring)
+{
+	ring.tail.store(ring.tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool alive(const uint32_t pid)
+{
+	return kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+}
+
+//
+// message encoding (native byte order - both sides are on the same host)
+//    request:  id u32, max suggestions u16, query length u16, filter u64, query
+//    response: id u32, flags u16, number of suggestions u16, then per suggestion: score f32, length u16, suggestion
+//
+template <class T>
+void put(char *&p, const T &value)
+{
+	memcpy(p, &value, sizeof(T));
+	p += sizeof(T);
+}
+
+template <class T>
+bool get(const char *&p, const char *end, T &value)
+{
+	if (p + sizeof(T) > end)
+		return false;
+
+	memcpy(&value, p, sizeof(T));
+	p += sizeof(T);
+	return true;
+}
+
+const size_t request_header = 4 + 2 + 2 + 8;
+
+const uint16_t degraded_flag = 1;  // search was cut short under load
+
+size_t region_size(const size_t n_channels)
+{
+	return offsetof(TRegion, channels) + n_channels * sizeof(TChannel);
+}
+
+// pid of running server of existing shared memory; 0 if there is none or its server terminated
+uint32_t running_server(const string &name)
+{
+	int fd(shm_open(name.c_str(), O_RDONLY, 0));
+	if (fd < 0)
+		return 0;
+
+	struct stat status;
+	void       *memory(MAP_FAILED);
+	if (fstat(fd, &status) == 0 && (size_t)status.st_size >= region_size(0))
+		memory = mmap(nullptr, region_size(0), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED)
+		return 0;
+
+	const TRegion *region((const TRegion *)memory);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const uint32_t server(region->magic == magic ? region->server : 0);
+	munmap(memory, region_size(0));
+
+	return server != 0 && server != (uint32_t)getpid() && alive(server) ? server : 0;
+}
+
+
+/*******************
+*   TIpcServer     *
+********************/
+TIpcServer::TIpcServer(const string &name, const size_t n_clients)
+	: name(name), region(nullptr), size(region_size(n_clients)), next_channel(0), stopped(false)
+{
+	if (n_clients == 0)
+		throw runtime_error("TIpcServer - no channels");
+
+	const uint32_t server(running_server(name));
+	if (server != 0)
+	{
+		char pid[16];
+		snprintf(pid, sizeof(pid), "%u", server);
+		throw runtime_error("TIpcServer - shared memory " + name + " is served by running process " + pid);
+	}
+
+	shm_unlink(name.c_str());  // left by crashed server
+
+	int fd(shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600));
+	if (fd < 0)
+		throw runtime_error("TIpcServer - cannot create shared memory " + name);
+
+	if (ftruncate(fd, (off_t)size) != 0)
+	{
+		close(fd);
+		shm_unlink(name.c_str());
+		throw runtime_error("TIpcServer - cannot size shared memory " + name);
+	}
+
+	void *memory(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+	close(fd);
+	if (memory == MAP_FAILED)
+	{
+		shm_unlink(name.c_str());
+		throw runtime_error("TIpcServer - cannot map shared memory " + name);
+	}
+
+	region = (TRegion *)memory;  // zero filled by ftruncate
+	region->version    = version;
+	region->n_channels = (uint32_t)n_clients;
+	region->server     = (uint32_t)getpid();
+
+	std::atomic_thread_fence(std::memory_order_release);
+	region->magic = magic;  // clients attach only to initialized region
+}
+
+TIpcServer::~TIpcServer()
+{
+	munmap(region, size);
+	shm_unlink(name.c_str());
+}
+
+bool TIpcServer::receive(TIpcRequest &request)
+{
+	const size_t n_channels(region->n_channels);
+
+	for (;;)
+	{
+		size_t channel(n_channels);
+		auto ready = [&]() -> bool
+		{
+			if (stopped)
+				return true;
+
+			for (size_t i(0); i < n_channels; ++i)
+			{
+				size_t c((next_channel + i) % n_channels);
+				if (front(region->channels[c].requests) != nullptr)
+				{
+					channel = c;
+					return true;
+				}
+			}
+
+			return false;
+		};
+
+		wait_until(region->doorbell, region->waiting, ready, []() { return true; });
+		if (stopped)
+			return false;
+
+		if (channel == n_channels)
+			continue;
+
+		next_channel = channel + 1;
+
+		TRing       &ring(region->channels[channel].requests);
+		const TSlot &slot(*front(ring));
+		const char  *p(slot.data);
+		const char  *end(slot.data + min((size_t)slot.size, sizeof(slot.data)));
+
+		uint16_t max_suggestions, length;
+		bool     valid(get(p, end, request.id) && get(p, end, max_suggestions) && get(p, end, length) && get(p, end, request.filter) &&
+			           p + length <= end);
+
+		if (valid)
+		{
+			request.channel         = channel;
+			request.max_suggestions = max_suggestions;
+			request.query.assign(p, length);
+		}
+
+		pop(ring);
+
+		if (valid)
+			return true;
+	}
+}
+
+void TIpcServer::respond(const TIpcRequest &request, const vector<string> &suggestions, const vector<float> &scores, const bool degraded)
+{
+	char     message[sizeof(TSlot().data)];
+	char    *p(message);
+	uint16_t n(0);
+
+	put(p, request.id);
+	put(p, degraded ? degraded_flag : (uint16_t)0);
+	char *count(p);
+	put(p, n);
+
+	for (size_t i(0); i < suggestions.size(); ++i)
+	{
+		const string &suggestion(suggestions[i]);
+		if ((size_t)(p - message) + 4 + 2 + suggestion.size() > sizeof(message))
+			break;
+
+		put(p, i < scores.size() ? scores[i] : (float).0);
+		put(p, (uint16_t)suggestion.size());
+		memcpy(p, suggestion.data(), suggestion.size());
+		p += suggestion.size();
+
+		++n;
+	}
+	memcpy(count, &n, sizeof(n));
+
+	push(region->channels[request.channel].responses, message, (uint32_t)(p - message));  // full only if client does not read responses
+}
+
+size_t TIpcServer::pending() const
+{
+	size_t n(0);
+	for (size_t i(0); i < region->n_channels; ++i)
+	{
+		const TRing &ring(region->channels[i].requests);
+		n += ring.head.load(std::memory_order_relaxed) - ring.tail.load(std::memory_order_relaxed);
+	}
+
+	return n;
+}
+
+void TIpcServer::stop()
+{
+	stopped = true;
+
+	region->doorbell.fetch_add(1);
+	wake(region->doorbell);
+}
+
+
+/*******************
+*   TIpcClient     *
+********************/
+TIpcClient::TIpcClient(const string &name)
+	: region(nullptr), channel(nullptr), size(0), next_id((uint32_t)getpid() << 12)
+{
+	int fd(shm_open(name.c_str(), O_RDWR, 0));
+	if (fd < 0)
+		throw runtime_error("TIpcClient - cannot open shared memory " + name);
+
+	struct stat status;
+	if (fstat(fd, &status) != 0 || (size_t)status.st_size < region_size(1))
+	{
+		close(fd);
+		throw runtime_error("TIpcClient - invalid shared memory " + name);
+	}
+
+	size = (size_t)status.st_size;
+	void *memory(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+	close(fd);
+	if (memory == MAP_FAILED)
+		throw runtime_error("TIpcClient - cannot map shared memory " + name);
+
+	region = (TRegion *)memory;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (region->magic != magic || region->version != version || size < region_size(region->n_channels))
+	{
+		munmap(region, size);
+		throw runtime_error("TIpcClient - incompatible shared memory " + name);
+	}
+
+	// claim free channel or channel of terminated client
+	const uint32_t pid((uint32_t)getpid());
+	for (size_t i(0); i < region->n_channels && channel == nullptr; ++i)
+	{
+		uint32_t owner(region->channels[i].owner.load());
+		if ((owner == 0 || !alive(owner)) && region->channels[i].owner.compare_exchange_strong(owner, pid))
+			channel = &region->channels[i];
+	}
+
+	if (channel == nullptr)
+	{
+		munmap(region, size);
+		throw runtime_error("TIpcClient - no free channel in " + name);
+	}
+
+	// responses to previous owner are skipped by id
+	channel->responses.tail.store(channel->responses.head.load());
+}
+
+TIpcClient::~TIpcClient()
+{
+	channel->owner.store(0);
+	munmap(region, size);
+}
+
+bool TIpcClient::autocomplete(const string         &query,
+	                                vector<string> &suggestions,
+								    vector<float>  &scores,
+						      const size_t          max_suggestions,
+						      const uint64_t        filter)
+{
+	suggestions.clear();
+	scores.clear();
+
+	char message[sizeof(TSlot().data)];
+	if (request_header + query.size() > sizeof(message))
+		throw runtime_error("TIpcClient::autocomplete - query too long");
+
+	const uint32_t id(next_id++);
+
+	char *p(message);
+	put(p, id);
+	put(p, (uint16_t)min(max_suggestions, (size_t)0xffff));
+	put(p, (uint16_t)query.size());
+	put(p, filter);
+	memcpy(p, query.data(), query.size());
+	p += query.size();
+
+	while (!push(channel->requests, message, (uint32_t)(p - message)))  // only if previous requests were not served yet
+		std::this_thread::yield();
+
+	region->doorbell.fetch_add(1);
+	if (region->waiting.load())
+		wake(region->doorbell);
+
+	TRing &ring(channel->responses);
+	for (;;)
+	{
+		const uint32_t server(region->server);
+		wait_until(ring.head, ring.waiting, [&]() { return front(ring) != nullptr; }, [&]() { return alive(server); });
+
+		const TSlot *slot(front(ring));
+		if (slot == nullptr)
+			throw runtime_error("TIpcClient::autocomplete - server terminated");
+
+		const char *p(slot->data);
+		const char *end(slot->data + min((size_t)slot->size, sizeof(slot->data)));
+
+		uint32_t response_id;
+		uint16_t flags, n;
+		if (!get(p, end, response_id) || response_id != id || !get(p, end, flags) || !get(p, end, n))
+		{
+			pop(ring);  // response to previous owner of channel
+			continue;
+		}
+
+		for (uint16_t i(0); i < n; ++i)
+		{
+			float    score;
+			uint16_t length;
+			if (!get(p, end, score) || !get(p, end, length) || p + length > end)
+				break;
+
+			scores.push_back(score);
+			suggestions.push_back(string(p, length));
+			p += length;
+		}
+
+		pop(ring);
+		return (flags & degraded_flag) == 0;
+	}
+}
@@ -0,0 +1,155 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <atomic>
+
+//
+//  shared memory transport for autocomplete clients on the same host as the server
+//    - server creates named shared memory region with one channel per client
+//    - channel has a request ring (client -> server) and a response ring (server -> client); rings are lock-free with
+//      single producer and single consumer
+//    - messages are compact binary: query with max suggestions and filter, suggestions with scores
+//    - waiting side spins briefly and then sleeps on futex (Linux); producer wakes it only if it sleeps
+//    - client library is TIpcClient; it does not depend on the index
+//
+
+namespace ipc
+{
+	const uint32_t magic         = 0x41435250;  // "ACRP"
+	const uint32_t version       = 2;
+	const size_t   ring_capacity = 16;          // messages, power of 2
+	const size_t   slot_size     = 1024;        // bytes per message including its size
+
+	struct TSlot
+	{
+		uint32_t size;
+		char     data[slot_size - sizeof(uint32_t)];
+	};
+
+	struct TRing  // single producer, single consumer
+	{
+		std::atomic<uint32_t> head;     // messages written by producer; futex word of consumer
+		char                  pad0[60];
+		std::atomic<uint32_t> tail;     // messages read by consumer
+		std::atomic<uint32_t> waiting;  // consumer sleeps on head
+		char                  pad1[56];
+		TSlot                 slots[ring_capacity];
+	};
+
+	struct TChannel
+	{
+		std::atomic<uint32_t> owner;  // pid of attached client; 0 -> free
+		char                  pad[60];
+		TRing                 requests;
+		TRing                 responses;
+	};
+
+	struct TRegion
+	{
+		uint32_t              magic;
+		uint32_t              version;
+		uint32_t              n_channels;
+		std::atomic<uint32_t> doorbell;  // incremented with each request; futex word of server
+		std::atomic<uint32_t> waiting;   // server sleeps on doorbell
+		uint32_t              server;    // pid of server process
+		char                  pad[40];
+		TChannel              channels[1];  // n_channels
+	};
+}
+
+struct TIpcRequest
+{
+	size_t   channel;
+	uint32_t id;
+	string   query;
+	size_t   max_suggestions;
+	uint64_t filter;
+};
+
+//
+//  TIpcServer
+//    - creates shared memory region; receive(...) and respond(...) are called from one thread
+//
+
+class TIpcServer
+{
+    public:
+
+		TIpcServer(const string &name, const size_t n_clients = 64);  // name is shm_open name, e.g. "/autocomplete"
+		~TIpcServer();
+
+		// wait for the next request (channels are served round robin); false after stop()
+		bool receive(TIpcRequest &request);
+
+		// suggestions that do not fit into message are dropped; degraded tells client that search was cut short under load
+		void respond(const TIpcRequest &request, const vector<string> &suggestions, const vector<float> &scores, const bool degraded = false);
+
+		size_t pending() const;  // requests waiting in all channels
+
+		void stop();  // can be called from another thread or signal handler
+
+    private:
+
+		string         name;
+		ipc::TRegion  *region;
+		size_t         size;
+		size_t         next_channel;  // round robin
+		volatile bool  stopped;
+
+		TIpcServer(const TIpcServer &);
+		TIpcServer &operator=(const TIpcServer &);
+};
+
+//
+//  TIpcClient
+//    - attaches to a free channel of server region; one client object per thread
+//
+
+class TIpcClient
+{
+    public:
+
+		TIpcClient(const string &name);
+		~TIpcClient();
+
+		// blocking round trip; scores are probabilities of suggestions given the query; returns false if server cut the
+		// search short under load (degraded) - suggestions can be missing
+		bool autocomplete(const string         &query,
+			                    vector<string> &suggestions,
+								vector<float>  &scores,
+						  const size_t          max_suggestions = 5,
+						  const uint64_t        filter = ~(uint64_t)0);
+
+    private:
+
+		ipc::TRegion   *region;
+		ipc::TChannel  *channel;
+		size_t          size;
+		uint32_t        next_id;
+
+		TIpcClient(const TIpcClient &);
+		TIpcClient &operator=(const TIpcClient &);
+};
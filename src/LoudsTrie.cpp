@@ -0,0 +1,178 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "LoudsTrie.h"
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include <algorithm>
+using std::min;
+
+#include <cmath>
+
+TLoudsTrie::TLoudsTrie()
+{
+}
+
+void TLoudsTrie::build(const TTrie &trie)
+{
+	louds.clear();
+	zeros.clear();
+	labels.clear();
+	probs.clear();
+	probabilities.clear();
+	masks.clear();
+
+	attribute_names = trie.attribute_values();
+	forms           = trie.display_forms();
+
+	vector<float>  node_probs;
+	vector<size_t> level_order(1, 0);  // TTrie nodes in level order - used as BFS queue
+	size_t         n_bits(0);
+	size_t         n_zeros(0);
+
+	for (size_t i(0); i < level_order.size(); ++i)
+	{
+		const TTrie::Node &node(trie.node(level_order[i]));
+
+		labels.push_back(node.c);
+		node_probs.push_back(node.prob);
+		if (!attribute_names.empty())  // attribute masks are stored only for dictionaries with attributes
+			masks.push_back(trie.attributes(level_order[i]));
+
+		if (louds.size() * 64 < n_bits + node.sub_trees.size() + 1)
+			louds.resize(louds.size() + 1 + (node.sub_trees.size() + 1) / 64, 0);
+
+		// degree in unary: one 1 bit per subtree followed by 0 bit
+		for (TTrie::Node::TSubTreeIt j(node.sub_trees.begin()); j != node.sub_trees.end(); ++j)
+		{
+			louds[n_bits / 64] |= (uint64_t)1 << (n_bits % 64);
+			++n_bits;
+
+			level_order.push_back(*j);
+		}
+
+		if (n_zeros % select_sample == 0)
+			zeros.push_back((uint32_t)n_bits);
+
+		++n_zeros;
+		++n_bits;
+
+		if (n_bits > 0xffffffffu)  // bit positions are stored in 32 bits
+			throw runtime_error("TLoudsTrie::build - too many nodes");
+	}
+
+	louds.resize(n_bits / 64 + 1, 0);  // next0 may read one word past the last bit
+
+	// quantize probabilities on log scale: p = 2^(-q * step)
+	float min_prob(1.);
+	for (vector<float>::const_iterator i(node_probs.begin()); i != node_probs.end(); ++i)
+		if (*i > .0)
+			min_prob = min(min_prob, *i);
+
+	const size_t levels(1 << 16);
+	const double step(min_prob < 1. ? -std::log(min_prob) / std::log(2.) / (levels - 1) : 1. / (levels - 1));
+
+	probabilities.resize(levels);
+	for (size_t q(0); q < levels; ++q)
+		probabilities[q] = (float)std::pow(2., -(double)q * step);
+
+	probs.reserve(node_probs.size());
+	for (vector<float>::const_iterator i(node_probs.begin()); i != node_probs.end(); ++i)
+	{
+		// round probability up
+		size_t q(*i > .0 ? (size_t)min((double)(levels - 1), std::floor(-std::log(*i) / std::log(2.) / step)) : levels - 1);
+		while (q > 0 && probabilities[q] < *i)
+			--q;
+
+		probs.push_back((uint16_t)q);
+	}
+}
+
+TLoudsTrie::TNodeRef TLoudsTrie::ref(const size_t index) const
+{
+	// degree bits of node with index i start after i-th 0 bit; 1 bits before them denote subtrees of previous nodes
+	size_t begin(index == 0 ? 0 : select0(index) + 1);
+	size_t end(next0(begin));
+
+	TNodeRef node;
+	node.id          = (uint32_t)index;
+	node.sub_trees   = (uint32_t)(begin - index + 1);
+	node.n_sub_trees = (uint16_t)(end - begin);
+	node.c           = labels[index];
+	node.prob        = prob(index);
+
+	return node;
+}
+
+uint64_t TLoudsTrie::attribute(const string &value) const
+{
+	for (size_t i(0); i < attribute_names.size(); ++i)
+		if (attribute_names[i] == value)
+			return (uint64_t)1 << i;
+
+	return 0;
+}
+
+size_t TLoudsTrie::select0(const size_t k) const
+{
+	size_t position(zeros[(k - 1) / select_sample]);
+	size_t remaining((k - 1) % select_sample);  // 0 bits to skip after sampled one
+
+	if (remaining == 0)
+		return position;
+
+	size_t   word((position + 1) / 64);
+	uint64_t bits(~louds[word] & (~(uint64_t)0 << ((position + 1) % 64)));
+
+	for (;;)
+	{
+		size_t count(popcount(bits));
+		if (count >= remaining)
+		{
+			for (; remaining > 1; --remaining)
+				bits &= bits - 1;
+
+			return word * 64 + ctz(bits);
+		}
+
+		remaining -= count;
+		bits = ~louds[++word];
+	}
+}
+
+size_t TLoudsTrie::next0(const size_t position) const
+{
+	size_t   word(position / 64);
+	uint64_t bits(~louds[word] & (~(uint64_t)0 << (position % 64)));
+
+	while (bits == 0)
+		bits = ~louds[++word];
+
+	return word * 64 + ctz(bits);
+}
+
+size_t TLoudsTrie::topology_memory() const
+{
+	return louds.size() * sizeof(uint64_t) + zeros.size() * sizeof(uint32_t);
+}
+
+size_t TLoudsTrie::memory() const
+{
+	return topology_memory() + labels.size() * sizeof(char) + probs.size() * sizeof(uint16_t) + probabilities.size() * sizeof(float) + 
+		   masks.size() * sizeof(uint64_t) + forms.memory();
+}
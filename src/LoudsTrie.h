@@ -0,0 +1,129 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+using std::vector;
+
+#include "AutocompleteUtils.h"
+
+//
+//  TLoudsTrie
+//    - succinct read-only encoding of TTrie for very large dictionaries
+//    - nodes are numbered in level order; subtrees of a node have consecutive numbers and keep TTrie order (by probability)
+//    - topology is level order unary degree sequence (LOUDS): 1^degree 0 per node, ~2 bits per node
+//      plus position of every 64th 0 bit for select (0.5 bit per node)
+//    - labels are packed one byte per node
+//    - probabilities are quantized to 16 bits on log scale; quantization rounds up so that
+//      max subtree probability remains an upper bound for the search
+//    - attribute masks (64 bits per node) are kept only if dictionary has attributes
+//
+
+class TLoudsTrie
+{
+    public:
+
+		TLoudsTrie();
+
+		void build(const TTrie &trie);  // trie can be minimized - shared subtries are expanded
+
+		// node reference caches what search needs to know about node without navigating bit vector again
+		struct TNodeRef
+		{
+			TNodeRef()
+				: id(0), sub_trees(0), prob(.0), n_sub_trees(0), c(0) {}
+
+			uint32_t id;
+			uint32_t sub_trees;    // id of the first subtree
+			float    prob;
+			uint16_t n_sub_trees;
+			char     c;
+
+			bool operator!=(const TNodeRef &rhs) const { return id != rhs.id; }
+		};
+
+		class TSubTreeIt  // iterates over consecutive subtree ids
+		{
+		    public:
+				TSubTreeIt(const size_t id = 0)
+					: id(id) {}
+
+				size_t      operator*() const                         { return id; }
+				TSubTreeIt& operator++()                              { ++id; return *this; }
+				bool        operator==(const TSubTreeIt &rhs) const   { return id == rhs.id; }
+				bool        operator!=(const TSubTreeIt &rhs) const   { return id != rhs.id; }
+
+		    private:
+				size_t id;
+		};
+
+		// node access used by TBasicAutocomplete
+		TNodeRef ref(const size_t index) const;
+		size_t   index(const TNodeRef &node) const { return node.id; };
+
+		size_t   roots() const              { return 1; };
+		size_t   root(const size_t) const   { return 0; };
+
+		char     label(const size_t index) const      { return labels[index]; };
+		float    prob(const size_t index) const       { return probabilities[probs[index]]; };
+		uint64_t attributes(const size_t index) const { return masks.empty() ? 0 : masks[index]; };
+		float    prob(const size_t index, const uint64_t) const { return prob(index); };  // no bounds per attribute
+
+		static char       label(const TNodeRef &node) { return node.c; };
+		static float      prob(const TNodeRef &node)  { return node.prob; };
+		static TSubTreeIt begin(const TNodeRef &node) { return TSubTreeIt(node.sub_trees); };
+		static TSubTreeIt end(const TNodeRef &node)   { return TSubTreeIt(node.sub_trees + node.n_sub_trees); };
+
+		// node will be expanded soon (interleaved search) - fetch labels, probabilities and attributes of its subtrees
+		void prefetch(const TNodeRef &node) const
+		{
+			if (node.n_sub_trees == 0)
+				return;
+
+			prefetch_memory(&labels[node.sub_trees]);
+			prefetch_memory(&probs[node.sub_trees]);
+			if (!masks.empty())
+				prefetch_memory(&masks[node.sub_trees]);
+		}
+
+		size_t size() const { return labels.size(); };
+
+		uint64_t attribute(const string &value) const;  // see TTrie::attribute
+
+		void display(const TNodeRef &, string &word) const { forms.display(word); };  // see TTrie::display
+
+		size_t topology_memory() const;  // bytes used by LOUDS bit vector and select directory
+		size_t memory() const;           // total bytes
+
+    private:
+
+		static const size_t select_sample = 64;  // every select_sample-th 0 bit position is stored
+
+		vector<uint64_t>  louds;
+		vector<uint32_t>  zeros;          // position of 0 bits number 1, select_sample + 1, 2 * select_sample + 1, ...
+		vector<char>      labels;
+		vector<uint16_t>  probs;          // quantized probabilities
+		vector<float>     probabilities;  // dequantization table
+		vector<uint64_t>  masks;          // attributes of nodes
+		vector<string>    attribute_names;
+		TDisplayForms     forms;
+
+		size_t select0(const size_t k) const;        // position of k-th 0 bit (k >= 1)
+		size_t next0(const size_t position) const;   // position of the first 0 bit at or after position
+};
@@ -0,0 +1,249 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Metrics.h"
+
+#include <cstdio>
+
+#include <algorithm>
+
+#include <cmath>
+
+#include <utility>
+using std::pair;
+
+/*******************
+*   THistogram     *
+********************/
+THistogram::THistogram()
+	: sum(0)
+{
+	for (unsigned int i(0); i < n_buckets; ++i)
+		buckets[i] = 0;
+}
+
+unsigned int THistogram::bucket(const uint64_t value)
+{
+	unsigned int i(0);
+	for (uint64_t v(value); v > 0 && i < n_buckets - 1; v >>= 1)
+		++i;
+
+	return i;
+}
+
+
+/*******************
+*   TMetrics       *
+********************/
+std::atomic<uint64_t> metrics_instances(0);
+
+TMetrics::TShard::TShard()
+	: queries(0), iteration_caps(0), degraded(0), coalesced(0), saved_expansions(0), cache_hits(0), cache_misses(0)
+{
+}
+
+TMetrics::TMetrics()
+	: id(++metrics_instances), index_memory(0), search_budget(0)
+{
+}
+
+TMetrics::~TMetrics()
+{
+	for (vector<TShard *>::iterator i(shards.begin()); i != shards.end(); ++i)
+		delete *i;
+}
+
+TMetrics::TShard &TMetrics::shard()
+{
+	// metrics instance id -> shard of this thread
+	static thread_local vector<pair<uint64_t, TShard *> > thread_shards;
+
+	for (vector<pair<uint64_t, TShard *> >::const_iterator i(thread_shards.begin()); i != thread_shards.end(); ++i)
+		if (i->first == id)
+			return *i->second;
+
+	TShard *shard(new TShard());
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		shards.push_back(shard);
+	}
+
+	thread_shards.push_back(std::make_pair(id, shard));
+	return *shard;
+}
+
+void TMetrics::record_query(const double latency_us, const TSearchStats &stats)
+{
+	TShard &s(shard());
+
+	s.queries.fetch_add(1, std::memory_order_relaxed);
+	if (stats.iteration_cap)
+		s.iteration_caps.fetch_add(1, std::memory_order_relaxed);
+	if (stats.degraded)
+		s.degraded.fetch_add(1, std::memory_order_relaxed);
+
+	s.latency.add((uint64_t)latency_us);
+	if (stats.coalesced)  // suggestions of identical concurrent search - no expansions of its own
+	{
+		s.coalesced.fetch_add(1, std::memory_order_relaxed);
+		s.saved_expansions.fetch_add(stats.expansions, std::memory_order_relaxed);
+		return;
+	}
+
+	s.expansions.add(stats.expansions);
+	s.frontier_peak.add(stats.frontier_peak);
+}
+
+void TMetrics::record_cache(const bool hit)
+{
+	TShard &s(shard());
+	(hit ? s.cache_hits : s.cache_misses).fetch_add(1, std::memory_order_relaxed);
+}
+
+void TMetrics::set_index_memory(const size_t bytes)
+{
+	index_memory = bytes;
+}
+
+void TMetrics::set_search_budget(const unsigned int budget)
+{
+	search_budget = budget;
+}
+
+void counter(string &text, const char *name, const char *help, const char *type, const double value)
+{
+	char line[256];
+	sprintf(line, "# HELP %s %s\n# TYPE %s %s\n%s %.15g\n", name, help, name, type, name, value);
+	text += line;
+}
+
+// scale converts bucket bounds and sum to exported unit
+void histogram(string &text, const char *name, const char *help, const vector<uint64_t> &buckets, const uint64_t sum, const double scale)
+{
+	char line[256];
+	sprintf(line, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+	text += line;
+
+	// upper bound of bucket i is 2^i - 1; the last bucket is unbounded
+	uint64_t count(0);
+	for (unsigned int i(0); i + 1 < buckets.size(); ++i)
+	{
+		count += buckets[i];
+
+		sprintf(line, "%s_bucket{le=\"%.15g\"} %llu\n", name, (double)(((uint64_t)1 << i) - 1) * scale, (unsigned long long)count);
+		text += line;
+	}
+	count += buckets.back();
+
+	sprintf(line, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.15g\n%s_count %llu\n",
+		    name, (unsigned long long)count, name, sum * scale, name, (unsigned long long)count);
+	text += line;
+}
+
+string TMetrics::prometheus() const
+{
+	uint64_t queries(0), iteration_caps(0), degraded(0), coalesced(0), saved(0), cache_hits(0), cache_misses(0);
+	uint64_t latency_sum(0), expansions_sum(0), frontier_sum(0);
+	vector<uint64_t> latency(THistogram::n_buckets, 0), expansions(THistogram::n_buckets, 0), frontier(THistogram::n_buckets, 0);
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		for (vector<TShard *>::const_iterator i(shards.begin()); i != shards.end(); ++i)
+		{
+			const TShard &s(**i);
+
+			queries        += s.queries.load(std::memory_order_relaxed);
+			iteration_caps += s.iteration_caps.load(std::memory_order_relaxed);
+			degraded       += s.degraded.load(std::memory_order_relaxed);
+			coalesced      += s.coalesced.load(std::memory_order_relaxed);
+			saved          += s.saved_expansions.load(std::memory_order_relaxed);
+			cache_hits     += s.cache_hits.load(std::memory_order_relaxed);
+			cache_misses   += s.cache_misses.load(std::memory_order_relaxed);
+
+			latency_sum    += s.latency.sum.load(std::memory_order_relaxed);
+			expansions_sum += s.expansions.sum.load(std::memory_order_relaxed);
+			frontier_sum   += s.frontier_peak.sum.load(std::memory_order_relaxed);
+
+			for (unsigned int b(0); b < THistogram::n_buckets; ++b)
+			{
+				latency[b]    += s.latency.buckets[b].load(std::memory_order_relaxed);
+				expansions[b] += s.expansions.buckets[b].load(std::memory_order_relaxed);
+				frontier[b]   += s.frontier_peak.buckets[b].load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	string text;
+	counter(text, "autocomplete_queries_total", "Number of autocomplete queries.", "counter", (double)queries);
+	histogram(text, "autocomplete_query_duration_seconds", "Autocomplete query latency.", latency, latency_sum, 1e-6);
+	histogram(text, "autocomplete_expansions", "Candidates expanded per query.", expansions, expansions_sum, 1.);
+	histogram(text, "autocomplete_frontier_peak", "Max number of candidates waiting for expansion per query.", frontier, frontier_sum, 1.);
+	counter(text, "autocomplete_iteration_cap_total", "Queries stopped at iteration limit without suggestion.", "counter", (double)iteration_caps);
+	counter(text, "autocomplete_degraded_total", "Queries stopped at search budget under load.", "counter", (double)degraded);
+	counter(text, "autocomplete_search_budget", "Max expansions per query under current load; 0 - full search.", "gauge", (double)search_budget.load());
+	counter(text, "autocomplete_coalesced_total", "Queries that shared the search of an identical concurrent query.", "counter", (double)coalesced);
+	counter(text, "autocomplete_saved_expansions_total", "Expansions not repeated thanks to coalesced queries.", "counter", (double)saved);
+	counter(text, "autocomplete_cache_hits_total", "Result cache hits.", "counter", (double)cache_hits);
+	counter(text, "autocomplete_cache_misses_total", "Result cache misses.", "counter", (double)cache_misses);
+	counter(text, "autocomplete_cache_hit_ratio", "Result cache hit ratio.", "gauge",
+		    cache_hits + cache_misses > 0 ? (double)cache_hits / (cache_hits + cache_misses) : .0);
+	counter(text, "autocomplete_index_memory_bytes", "Memory used by index.", "gauge", (double)index_memory.load());
+
+	return text;
+}
+
+
+/*******************
+*   TLoadControl   *
+********************/
+TLoadControl::TLoadControl(const double target_us, const unsigned int max_budget, const unsigned int min_budget)
+	: target_us(target_us), max_budget(max_budget), min_budget(min_budget), latency(.0), recorded(0), queue(0), current(0)
+{
+}
+
+void TLoadControl::record(const double latency_us, const size_t queue_depth)
+{
+	const unsigned int request_shift = 40;
+
+	size_t max_queue(queue.load(std::memory_order_relaxed));
+	while (queue_depth > max_queue && !queue.compare_exchange_weak(max_queue, queue_depth, std::memory_order_relaxed))
+		;
+
+	// request count and service time are added at once, so the adjustment takes both of the same requests
+	const uint64_t request((uint64_t)1 << request_shift);
+	if ((recorded.fetch_add(request + (uint64_t)(latency_us + .5), std::memory_order_relaxed) >> request_shift) + 1 != interval)
+		return;
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	const uint64_t     sum(recorded.exchange(0, std::memory_order_relaxed));
+	const unsigned int requests((unsigned int)(sum >> request_shift));
+	const double       mean_us((double)(sum & (request - 1)) / requests);
+
+	// moving average as if every request moved it by 1/interval of its difference
+	latency = latency == .0 ? mean_us : mean_us + (latency - mean_us) * std::pow(1. - 1. / interval, (double)requests);
+
+	const double response_us((queue.exchange(0, std::memory_order_relaxed) + 1) * latency);  // of a request arriving now
+
+	unsigned int budget(current.load(std::memory_order_relaxed));
+	if (response_us > target_us)  // overload - cut budget
+		budget = budget == 0 ? max_budget : std::max(min_budget, budget / 2);
+	else
+	if (budget != 0 && response_us < target_us / 2)  // load fell - restore budget
+		budget = budget * 2 > max_budget ? 0 : budget * 2;
+
+	current.store(budget, std::memory_order_relaxed);
+}
@@ -0,0 +1,145 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <atomic>
+#include <mutex>
+
+#include "Autocomplete.h"
+
+//
+//  THistogram
+//    - lock-free histogram with log2 buckets: bucket i counts values in [2^(i-1), 2^i), bucket 0 counts 0
+//
+
+class THistogram
+{
+    public:
+
+		static const unsigned int n_buckets = 40;
+
+		THistogram();
+
+		void add(const uint64_t value)
+		{
+			buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+			sum.fetch_add(value, std::memory_order_relaxed);
+		}
+
+		static unsigned int bucket(const uint64_t value);
+
+		std::atomic<uint64_t> buckets[n_buckets];
+		std::atomic<uint64_t> sum;
+};
+
+//
+//  TMetrics
+//    - operational metrics of autocomplete service exported in Prometheus text format
+//    - every thread records into its own shard of counters, so recording needs no locks and threads do not contend
+//      for counters; shards are summed when metrics are exported
+//
+
+class TMetrics
+{
+    public:
+
+		TMetrics();
+		~TMetrics();
+
+		void record_query(const double latency_us, const TSearchStats &stats);  // coalesced queries count as saved work
+		void record_cache(const bool hit);                 // lookup in result cache
+		void set_index_memory(const size_t bytes);
+		void set_search_budget(const unsigned int budget);  // current budget of TLoadControl; 0 -> full search
+
+		string prometheus() const;  // text exposition format
+
+    private:
+
+		struct TShard
+		{
+			TShard();
+
+			std::atomic<uint64_t> queries;
+			std::atomic<uint64_t> iteration_caps;
+			std::atomic<uint64_t> degraded;
+			std::atomic<uint64_t> coalesced;
+			std::atomic<uint64_t> saved_expansions;  // by coalesced queries
+			std::atomic<uint64_t> cache_hits;
+			std::atomic<uint64_t> cache_misses;
+
+			THistogram latency;        // microseconds
+			THistogram expansions;
+			THistogram frontier_peak;
+		};
+
+		TShard &shard();  // shard of the calling thread
+
+		const uint64_t        id;            // identifies metrics instance in thread local shard lookup
+		mutable std::mutex    lock;          // guards list of shards
+		vector<TShard *>      shards;
+		std::atomic<uint64_t> index_memory;
+		std::atomic<uint64_t> search_budget;
+
+		TMetrics(const TMetrics &);
+		TMetrics &operator=(const TMetrics &);
+};
+
+//
+//  TLoadControl
+//    - adapts per-request search budget (max expansions, see TBasicAutocomplete::autocomplete) to load
+//    - response time of a new request is estimated from queue depth and recent service time (moving average) as
+//      (queue depth + 1) * service time; every interval requests the budget is cut if the estimate exceeds target
+//      (full search -> max_budget -> halved down to min_budget) and doubled back up to full search if the estimate
+//      is below half of target
+//    - budget() and record() take no locks; only the adjustment every interval requests is serialized
+//
+
+class TLoadControl
+{
+    public:
+
+		TLoadControl(const double target_us = 20000., const unsigned int max_budget = 4000, const unsigned int min_budget = 125);
+
+		unsigned int budget() const { return current.load(std::memory_order_relaxed); };  // 0 -> full search
+
+		// service time of finished request and number of requests waiting for service
+		void record(const double latency_us, const size_t queue_depth);
+
+		static const unsigned int interval = 16;  // requests between adjustments
+
+    private:
+
+		const double       target_us;
+		const unsigned int max_budget, min_budget;
+
+		std::mutex                lock;      // serializes adjustments
+		double                    latency;   // moving average of service time; guarded by lock
+		std::atomic<uint64_t>     recorded;  // since last adjustment: requests (high 24 bits) and sum of their service time in us
+		std::atomic<size_t>       queue;     // max queue depth since last adjustment
+		std::atomic<unsigned int> current;
+
+		TLoadControl(const TLoadControl &);
+		TLoadControl &operator=(const TLoadControl &);
+};
@@ -0,0 +1,299 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "PagedTrie.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+
+#include <deque>
+using std::deque;
+
+#include <stdexcept>
+using std::runtime_error;
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//
+// index file: header page, node pages, attribute masks (page aligned), '\0' terminated attribute values,
+// '\0' terminated pairs of word and its display form (case folded dictionary)
+//
+namespace
+{
+	const char magic[8] = {'A', 'C', 'P', 'A', 'G', 'E', 'S', '2'};
+
+	struct THeader
+	{
+		char     magic[8];
+		uint64_t page_size;
+		uint64_t n_nodes;
+		uint64_t masks_offset;  // 0 -> dictionary has no attributes
+		uint64_t names_offset;
+		uint64_t n_names;
+		uint64_t n_forms;
+		uint64_t file_size;
+	};
+
+	size_t align(const size_t offset, const size_t page_size)
+	{
+		return (offset + page_size - 1) / page_size * page_size;
+	}
+
+	struct TGroup  // subtrees of TTrie node, placed after their parent in packed nodes
+	{
+		TGroup(const size_t parent = 0, const size_t node = 0)
+			: parent(parent), node(node) {}
+
+		size_t parent;
+		size_t node;
+	};
+}
+
+TPagedTrie::TPagedTrie()
+	: mapped(nullptr), mapped_bytes(0), page_bytes(0), n_nodes(0), nodes(nullptr), masks(nullptr)
+{
+}
+
+TPagedTrie::~TPagedTrie()
+{
+	close();
+}
+
+void TPagedTrie::write(const TTrie &trie, const string &file_name, const size_t page_size)
+{
+	const size_t slots(page_size / sizeof(TNode));  // nodes per page
+	if (page_size % sizeof(TNode) != 0 || slots < 2 || page_size < sizeof(THeader))
+		throw runtime_error("TPagedTrie::write - page size must be a multiple of 16 bytes and at least 64 bytes");
+
+	const vector<string> &names(trie.attribute_values());
+	const TDisplayForms  &forms(trie.display_forms());
+
+	TNode empty;
+	memset(&empty, 0, sizeof(empty));  // unused slot - terminator label, no subtrees
+
+	vector<TNode>    packed;
+	vector<uint64_t> packed_masks;
+
+	TNode root(empty);
+	root.prob        = trie.node(0).prob;
+	root.n_sub_trees = (uint16_t)trie.node(0).sub_trees.size();
+	root.c           = trie.node(0).c;
+	packed.push_back(root);
+	packed_masks.push_back(trie.attributes(0));
+
+	// a page is filled with groups in level order, starting at its first group; groups that do not fit
+	// are deferred and start new pages in level order, so pages of upper levels come first
+	deque<TGroup> page(1, TGroup(0, 0)), deferred;
+	size_t        page_end(slots);
+
+	while (!page.empty() || !deferred.empty())
+	{
+		TGroup group;
+		if (!page.empty())
+		{
+			group = page.front();
+			page.pop_front();
+
+			if (packed.size() + trie.node(group.node).sub_trees.size() > page_end)
+			{
+				deferred.push_back(group);
+				continue;
+			}
+		}
+		else
+		{
+			group = deferred.front();
+			deferred.pop_front();
+
+			const size_t n(trie.node(group.node).sub_trees.size());
+			if (packed.size() + n > page_end)  // new page; groups larger than a page span several pages
+			{
+				packed.resize(page_end, empty);
+				packed_masks.resize(page_end, 0);
+				page_end += (n + slots - 1) / slots * slots;
+			}
+		}
+
+		if (packed.size() + trie.node(group.node).sub_trees.size() > 0xffffffffu)  // ids are stored in 32 bits
+			throw runtime_error("TPagedTrie::write - too many nodes");
+
+		packed[group.parent].first = (uint32_t)packed.size();
+
+		const vector<size_t> &sub_trees(trie.node(group.node).sub_trees);
+		for (vector<size_t>::const_iterator i(sub_trees.begin()); i != sub_trees.end(); ++i)
+		{
+			const TTrie::Node &node(trie.node(*i));
+
+			TNode n(empty);
+			n.prob        = node.prob;
+			n.n_sub_trees = (uint16_t)node.sub_trees.size();
+			n.c           = node.c;
+
+			if (!node.sub_trees.empty())
+				page.push_back(TGroup(packed.size(), *i));
+
+			packed.push_back(n);
+			packed_masks.push_back(trie.attributes(*i));
+		}
+	}
+	packed.resize(page_end, empty);
+
+	THeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, magic, sizeof(magic));
+	header.page_size    = page_size;
+	header.n_nodes      = packed.size();
+	header.masks_offset = names.empty() ? 0 : page_size + packed.size() * sizeof(TNode);
+	header.names_offset = page_size + packed.size() * sizeof(TNode) + (names.empty() ? 0 : align(packed.size() * sizeof(uint64_t), page_size));
+	header.n_names      = names.size();
+	header.n_forms      = forms.size();
+	header.file_size    = header.names_offset;
+	for (vector<string>::const_iterator i(names.begin()); i != names.end(); ++i)
+		header.file_size += i->size() + 1;
+	for (TDisplayForms::TIt i(forms.begin()); i != forms.end(); ++i)
+		header.file_size += i->first.size() + 1 + i->second.size() + 1;
+
+	FILE *f(fopen(file_name.c_str(), "wb"));
+	if (!f)
+		throw runtime_error("TPagedTrie::write - cannot create file " + file_name);
+
+	vector<char> header_page(page_size, 0);
+	memcpy(&header_page[0], &header, sizeof(header));
+
+	bool ok(fwrite(&header_page[0], 1, page_size, f) == page_size &&
+			fwrite(&packed[0], sizeof(TNode), packed.size(), f) == packed.size());
+
+	if (ok && !names.empty())
+	{
+		packed_masks.resize(align(packed.size() * sizeof(uint64_t), page_size) / sizeof(uint64_t), 0);
+		ok = fwrite(&packed_masks[0], sizeof(uint64_t), packed_masks.size(), f) == packed_masks.size();
+	}
+
+	for (vector<string>::const_iterator i(names.begin()); ok && i != names.end(); ++i)
+		ok = fwrite(i->c_str(), 1, i->size() + 1, f) == i->size() + 1;
+
+	for (TDisplayForms::TIt i(forms.begin()); ok && i != forms.end(); ++i)
+		ok = fwrite(i->first.c_str(), 1, i->first.size() + 1, f) == i->first.size() + 1 &&
+			 fwrite(i->second.c_str(), 1, i->second.size() + 1, f) == i->second.size() + 1;
+
+	if (fclose(f) != 0 || !ok)
+		throw runtime_error("TPagedTrie::write - cannot write file " + file_name);
+}
+
+void TPagedTrie::open(const string &file_name)
+{
+	close();
+
+	int fd(::open(file_name.c_str(), O_RDONLY));
+	if (fd < 0)
+		throw runtime_error("TPagedTrie::open - cannot open file " + file_name);
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(THeader))
+	{
+		::close(fd);
+		throw runtime_error("TPagedTrie::open - not an index file " + file_name);
+	}
+
+	void *m(mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0));
+	::close(fd);
+	if (m == MAP_FAILED)
+		throw runtime_error("TPagedTrie::open - cannot map file " + file_name);
+
+	mapped       = m;
+	mapped_bytes = st.st_size;
+
+	THeader header;
+	memcpy(&header, mapped, sizeof(header));
+	if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.file_size != mapped_bytes || header.page_size < sizeof(THeader) ||
+		header.page_size + header.n_nodes * sizeof(TNode) > mapped_bytes || header.names_offset > mapped_bytes)
+	{
+		close();
+		throw runtime_error("TPagedTrie::open - not an index file " + file_name);
+	}
+
+	madvise(mapped, mapped_bytes, MADV_RANDOM);  // pages are packed by subtree - read ahead would fetch unrelated subtrees
+
+	const char *base((const char *)mapped);
+
+	page_bytes = header.page_size;
+	n_nodes    = header.n_nodes;
+	nodes      = (const TNode *)(base + page_bytes);
+	masks      = header.masks_offset == 0 ? nullptr : (const uint64_t *)(base + header.masks_offset);
+
+	const char *name(base + header.names_offset);
+	for (; attribute_names.size() < header.n_names; name += attribute_names.back().size() + 1)
+		attribute_names.push_back(string(name, strnlen(name, base + mapped_bytes - name)));
+
+	for (uint64_t i(0); i < header.n_forms; ++i)
+	{
+		const string word(name, strnlen(name, base + mapped_bytes - name));
+		name += word.size() + 1;
+
+		const string form(name, strnlen(name, base + mapped_bytes - name));
+		name += form.size() + 1;
+
+		forms.add(word, form);
+	}
+}
+
+size_t TPagedTrie::pin(const size_t bytes)
+{
+	const size_t node_bytes(std::min(bytes, n_nodes * sizeof(TNode)) / page_bytes * page_bytes);
+	if (node_bytes == 0)
+		return 0;
+
+	if (mlock(nodes, node_bytes) != 0)
+		throw runtime_error("TPagedTrie::pin - cannot lock pages (see RLIMIT_MEMLOCK)");
+
+	if (!masks)
+		return node_bytes;
+
+	const size_t mask_bytes(node_bytes / sizeof(TNode) * sizeof(uint64_t));
+	if (mlock(masks, mask_bytes) != 0)
+		throw runtime_error("TPagedTrie::pin - cannot lock pages (see RLIMIT_MEMLOCK)");
+
+	return node_bytes + mask_bytes;
+}
+
+void TPagedTrie::close()
+{
+	if (mapped)
+		munmap(mapped, mapped_bytes);
+
+	mapped       = nullptr;
+	mapped_bytes = 0;
+	page_bytes   = 0;
+	n_nodes      = 0;
+	nodes        = nullptr;
+	masks        = nullptr;
+	attribute_names.clear();
+	forms.clear();
+}
+
+uint64_t TPagedTrie::attribute(const string &value) const
+{
+	for (size_t i(0); i < attribute_names.size(); ++i)
+		if (attribute_names[i] == value)
+			return (uint64_t)1 << i;
+
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+Copyright (C) 2012 Matevz Kovacic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+using std::vector;
+
+#include "AutocompleteUtils.h"
+
+//
+//  TPagedTrie
+//    - read-only trie in index file that is mapped into memory (mmap) - for dictionaries larger than memory
+//    - nodes are packed into pages: a page is filled with a subtree in level order, subtrees that do not fit
+//      start new pages, so a walk from root to leaf touches few pages and unrelated nodes share no page
+//    - pages of upper levels come first in file; they can be locked in memory (pin)
+//    - subtrees of a node are consecutive nodes in TTrie order (by probability); 16 bytes per node,
+//      attribute masks (if dictionary has attributes) are in the same order in a separate section
+//
+
+class TPagedTrie
+{
+    public:
+
+		TPagedTrie();
+		~TPagedTrie();
+
+		// pack trie into index file; trie can be minimized - shared subtries are expanded
+		static void write(const TTrie &trie, const string &file_name, const size_t page_size = 4096);
+
+		void   open(const string &file_name);
+		size_t pin(const size_t bytes);  // lock pages of upper levels in memory; returns bytes locked
+
+		struct TNode
+		{
+			float    prob;
+			uint32_t first;   // id of the first subtree
+			uint16_t n_sub_trees;
+			char     c;
+			uint8_t  padding[5];  // 16 bytes - nodes do not straddle pages
+		};
+
+		class TSubTreeIt  // iterates over consecutive subtree ids
+		{
+		    public:
+				TSubTreeIt(const size_t id = 0)
+					: id(id) {}
+
+				size_t      operator*() const                         { return id; }
+				TSubTreeIt& operator++()                              { ++id; return *this; }
+				bool        operator==(const TSubTreeIt &rhs) const   { return id == rhs.id; }
+				bool        operator!=(const TSubTreeIt &rhs) const   { return id != rhs.id; }
+
+		    private:
+				size_t id;
+		};
+
+		// node access used by TBasicAutocomplete
+		typedef const TNode *TNodeRef;
+
+		TNodeRef ref(const size_t index) const      { return nodes + index; };
+		size_t   index(const TNodeRef node) const   { return node - nodes; };
+
+		size_t   roots() const              { return 1; };
+		size_t   root(const size_t) const   { return 0; };
+
+		char     label(const size_t index) const      { return nodes[index].c; };
+		float    prob(const size_t index) const       { return nodes[index].prob; };
+		uint64_t attributes(const size_t index) const { return masks ? masks[index] : 0; };
+		float    prob(const size_t index, const uint64_t) const { return prob(index); };  // no bounds per attribute
+
+		static char       label(const TNodeRef node) { return node->c; };
+		static float      prob(const TNodeRef node)  { return node->prob; };
+		static TSubTreeIt begin(const TNodeRef node) { return TSubTreeIt(node->first); };
+		static TSubTreeIt end(const TNodeRef node)   { return TSubTreeIt(node->first + node->n_sub_trees); };
+
+		// node will be expanded soon (interleaved search) - fetch its subtrees
+		void prefetch(const TNodeRef node) const
+		{
+			for (size_t k(0); k < node->n_sub_trees && k < 16; k += 4)
+				prefetch_memory(nodes + node->first + k);
+		}
+
+		size_t size() const { return n_nodes; };  // including unused slots at the ends of pages (label (char)0)
+
+		uint64_t attribute(const string &value) const;  // see TTrie::attribute
+
+		void display(const TNodeRef, string &word) const { forms.display(word); };  // see TTrie::display
+
+		size_t page_size() const                  { return page_bytes; };
+		size_t pages() const                      { return n_nodes * sizeof(TNode) / page_bytes; };  // node pages
+		size_t page(const size_t index) const     { return index * sizeof(TNode) / page_bytes; };
+		size_t memory() const                     { return mapped_bytes; };                          // bytes mapped (index file size)
+
+    private:
+
+		TPagedTrie(const TPagedTrie &);
+		TPagedTrie &operator=(const TPagedTrie &);
+
+		void close();
+
+		void           *mapped;
+		size_t          mapped_bytes;
+		size_t          page_bytes;
+		size_t          n_nodes;
+		const TNode    *nodes;
+		const uint64_t *masks;  // nullptr if dictionary has no attributes
+		vector<string>  attribute_names;
+		TDisplayForms   forms;          // read from index file
+};